@@ -17,6 +17,10 @@ public:
 	glm::vec3 getUp() const { return m_up; }
 	glm::vec3 getRight() const { return m_right; }
 
+	float getFov() const { return glm::radians(m_fov); } // Vertical, in radians
+	float getAspectRatio() const { return (float)m_width / (float)m_height; }
+	float getNearClippingPlane() const { return m_nearClippingPlane; }
+
 
 	void setPosition(glm::vec3 position);
 
@@ -36,6 +40,7 @@ private:
 	float m_yaw;
 	float m_pitch;
 
+	float m_fov = 60.0f;
 	float m_farClippingPlane = 500.0f;
 	float m_nearClippingPlane = 0.1f;
 };
@@ -2,17 +2,22 @@
 
 #include "cube.h"
 #include "mesh.h"
+#include "chunk_section.h"
 #include "vector"
 
+#include <array>
+#include <cstdint>
 #include <memory>
+#include <random>
+#include <utility>
 
 #include "glad/glad.h"
 
-struct fnl_state;
-
 namespace voxl
 {
 class ChunkManager;
+class TerrainCache;
+struct ChunkMeshData;
 
 enum class BiomeType {
 	Forest = 0, 
@@ -20,54 +25,178 @@ enum class BiomeType {
 	Desert,
 	Mountains
 };
+const int BIOME_COUNT = 4;
 
 struct BiomeBlend {
 	BiomeType type;
 	float weight; 
 };
 
+// The one or two biomes blended at a column
+struct BiomeBlends {
+	std::array<BiomeBlend, 2> blends;
+	int count = 0;
+
+	void add(const BiomeBlend& blend) { blends[count++] = blend; }
+	const BiomeBlend* begin() const { return blends.data(); }
+	const BiomeBlend* end() const { return blends.data() + count; }
+};
+
+// Steps a chunk goes through, in order. The stage of a chunk is the last step it completed.
+enum class ChunkStage : uint8_t {
+	Empty = 0,
+	Terrain,   // Stone, soil and surface blocks up to the terrain height
+	Fluids,    // Water filled up to sea level
+	Decorated, // Trees placed, the voxels are final
+	Lit,       // Sky and block light flooded in, see LightEngine
+	Meshed     // Section meshes requested
+};
+const int CHUNK_STAGE_COUNT = 6;
+
+const char* getStageName(ChunkStage stage);
+
+// Block a decoration placed outside the chunk that produced it, in world block coordinates
+struct DecorationWrite {
+	int x, y, z;
+	BlockType type;
+};
+
+// GPU meshes of one vertical section of a chunk
+struct SectionMesh {
+	std::unique_ptr<Mesh> mesh;
+	std::unique_ptr<Mesh> waterMesh;
+	std::unique_ptr<OcclusionMap> occlusionMap; // Shared by both meshes, null when neither exists
+
+	int faceCount = 0;
+	int quadCount = 0;
+	bool skipped = false;
+	unsigned int revision = 0;
+};
+
 class Chunk {
 
 
 public:
 	static const int CHUNK_SIZE = 32;
 	static const int CHUNK_HEIGHT = 128;
+	static const int SECTION_COUNT = CHUNK_HEIGHT / ChunkSection::SIZE;
 
 	Chunk(const Chunk* chunk);
 	Chunk(int x, int y, int z, ChunkManager* chunkManager);
 	~Chunk();
 
-	BlockType cubes[CHUNK_SIZE][CHUNK_HEIGHT][CHUNK_SIZE];
-
-	Mesh* getMesh() { return m_mesh.get(); }
-	Mesh* getWaterMesh() { return m_waterMesh.get(); }
+	// Null while the section has not been meshed yet or has nothing to draw
+	Mesh* getMesh(int section) { return m_sectionMeshes[section].mesh.get(); }
+	Mesh* getWaterMesh(int section) { return m_sectionMeshes[section].waterMesh.get(); }
+	OcclusionMap* getOcclusionMap(int section) { return m_sectionMeshes[section].occlusionMap.get(); }
 
 	glm::vec3 getPosition() const { return glm::vec3(m_x, m_y, m_z); }
-	int getIndexCount() { return m_indexCount; }
 
-	void setBlockType(int x, int y, int z, BlockType type);
+	// Visible faces and quads actually emitted, summed over the sections
+	int getFaceCount() const;
+	int getQuadCount() const;
+	bool isSectionSkipped(int section) const { return m_sectionMeshes[section].skipped; }
 
-	void generate();
-	void generateMesh();
+	BlockType getBlockType(int x, int y, int z) const
+	{
+		return m_sections[y / ChunkSection::SIZE].get(x, y % ChunkSection::SIZE, z);
+	}
+	void setBlockType(int x, int y, int z, BlockType type);
 
-	bool isFaceVisible(int x, int y, int z, int direction, BlockType faceType);
+	const ChunkSection& getSection(int index) const { return m_sections[index]; }
+	ChunkSection& getSection(int index) { return m_sections[index]; }
+
+	// Packed sky and block light, see LightSection. Only meaningful once the chunk is Lit.
+	uint8_t getLight(int x, int y, int z) const
+	{
+		return m_light[y / ChunkSection::SIZE].get(x, y % ChunkSection::SIZE, z);
+	}
+	void setLight(int x, int y, int z, uint8_t light)
+	{
+		m_light[y / ChunkSection::SIZE].set(x, y % ChunkSection::SIZE, z, light);
+	}
+	const LightSection& getLightSection(int index) const { return m_light[index]; }
+	LightSection& getLightSection(int index) { return m_light[index]; }
+
+	// Set by block changes after generation, cleared once the chunk is written to or read from disk.
+	// Generation can be repeated from the seed, it doesn't need saving.
+	bool isModified() const { return m_modified; }
+	void setModified(bool modified) { m_modified = modified; }
+
+	// Set by player edits since the chunk was loaded or generated. A chunk that was never edited
+	// can be dropped without saving, generating it again and replaying its received writes gives it back.
+	bool isEdited() const { return m_edited; }
+	void setEdited() { m_edited = true; }
+
+	// Bytes used by the voxel and light data of this chunk
+	size_t getMemoryUsage() const;
+	size_t getLightMemoryUsage() const;
+	// Bytes used by the section meshes, on the CPU and the GPU
+	size_t getMeshMemoryUsage() const;
+
+	// Frees every section mesh, results of meshing still in flight are dropped
+	void releaseMeshes();
+
+	// Fills the chunk from the terrain of a world seed. The result only depends on the seed and the
+	// chunk position, so any chunk can be generated on any thread in any order.
+	// Runs the three generation stages below one after the other.
+	void generate(TerrainCache& terrain);
+
+	// Generation stages, each one expects the chunk to be at the stage before it
+	void generateTerrain(TerrainCache& terrain);
+	void generateFluids();
+	void decorate(TerrainCache& terrain);
+
+	// Blocks decorate() placed past the chunk borders, for the neighbors they fall in. Taken once.
+	std::vector<DecorationWrite> takeOutgoingWrites() { return std::exchange(m_outgoingWrites, {}); }
+	// Applies a write from the decoration of a neighbor, once this chunk is decorated itself.
+	// Only air is filled, so the neighbors can be decorated in any order. Returns true when the block changed.
+	bool applyDecorationWrite(const DecorationWrite& write);
+	// Writes of neighbors applied since the chunk was last saved
+	std::vector<DecorationWrite> takeReceivedWrites() { return std::exchange(m_receivedWrites, {}); }
+
+	ChunkStage getStage() const { return m_stage; }
+	void setStage(ChunkStage stage) { m_stage = stage; }
+
+	// Seed of the random stream of the chunk at chunk coordinates (chunkX, chunkZ)
+	static uint64_t getChunkSeed(uint32_t worldSeed, int chunkX, int chunkZ);
+
+	// Meshes are built off-thread from a ChunkSnapshot, this uploads the result
+	void uploadMesh(int section, ChunkMeshData data);
+
+	// Revision of the latest mesh request of a section, results of older requests are dropped.
+	// 0 means none is pending.
+	void setMeshRevision(int section, unsigned int revision) { m_sectionMeshes[section].revision = revision; }
+	unsigned int getMeshRevision(int section) const { return m_sectionMeshes[section].revision; }
+
+	// Voxel and mesh bytes the manager counts for this chunk, as of the last time it measured it
+	size_t getCountedBytes() const { return m_countedBytes; }
+	void setCountedBytes(size_t bytes) { m_countedBytes = bytes; }
 
 private:
 	int m_x, m_y, m_z;
-	int m_indexCount;
+	bool m_modified = false;
+	bool m_edited = false;
+	ChunkStage m_stage = ChunkStage::Empty;
+	size_t m_countedBytes = 0;
+
+	// Inputs shared by the generation stages, dropped once the chunk is decorated
+	struct GenerationData {
+		std::array<float, CHUNK_SIZE * CHUNK_SIZE> biomeValues;
+		std::array<uint8_t, CHUNK_SIZE * CHUNK_SIZE> surfaceHeights;
+	};
+	std::unique_ptr<GenerationData> m_generation;
+	std::vector<DecorationWrite> m_outgoingWrites;
+	std::vector<DecorationWrite> m_receivedWrites;
 
 	ChunkManager* m_chunkManager;
 
-	std::unique_ptr<Mesh> m_mesh;
-	std::unique_ptr<Mesh> m_waterMesh;
-
-	void addFace(std::vector<glm::vec3>& vertices, std::vector<glm::vec3>& normals, std::vector<unsigned int>& indices,
-				int x, int y, int z, int faceIndex);
+	std::array<ChunkSection, SECTION_COUNT> m_sections;
+	std::array<LightSection, SECTION_COUNT> m_light;
 
-	BiomeType getBiomeType(fnl_state& noise, int x, int z) const;
-	std::vector<BiomeBlend> calculateBiomeWeights(fnl_state& biomeNoise, int x, int z);
+	std::array<SectionMesh, SECTION_COUNT> m_sectionMeshes;
 
-	void placeTree(int x, int y, int z);
+	void placeTree(int x, int y, int z, std::mt19937& random);
 };
 
 } // namespace voxl
\ No newline at end of file
@@ -0,0 +1,79 @@
+#pragma once
+
+#include "glm/glm.hpp"
+#include "chunk.h"
+#include <array>
+#include <span>
+#include <vector>
+
+namespace voxl
+{
+
+struct ChunkEntry {
+	glm::ivec3 chunkPos;
+	Chunk* chunk = nullptr;
+};
+
+// GL handles of one section mesh, indexCount 0 when there is nothing to draw
+struct SectionDraw {
+	unsigned int vao = 0;
+	unsigned int indexCount = 0;
+	unsigned int occlusionMap = 0; // Texture of the section's OcclusionMap
+};
+
+// Everything the renderer needs to draw a loaded chunk, without touching the chunk itself
+struct RenderEntry {
+	glm::vec3 origin = glm::vec3(0.0f);
+	glm::vec3 boundsMin = glm::vec3(0.0f); // World space box around the sections that have a mesh
+	glm::vec3 boundsMax = glm::vec3(0.0f);
+	std::array<SectionDraw, Chunk::SECTION_COUNT> opaque;
+	std::array<SectionDraw, Chunk::SECTION_COUNT> water;
+};
+
+// Loaded chunks in a fixed SIZE x SIZE window that wraps around, indexed by chunk coordinates
+// modulo SIZE. Lookups are a mask and a compare, no hashing. Two chunks SIZE apart share a slot,
+// the window must be wider than the load diameter for that never to happen between loaded chunks.
+class ChunkGrid {
+public:
+	static const int SIZE = 32; // Power of two
+
+	Chunk* get(int chunkX, int chunkZ) const
+	{
+		const Slot& slot = m_slots[slotIndex(chunkX, chunkZ)];
+		return slot.entry >= 0 && slot.chunkX == chunkX && slot.chunkZ == chunkZ ? slot.chunk : nullptr;
+	}
+	Chunk* get(const glm::ivec3& chunkPos) const { return get(chunkPos.x, chunkPos.z); }
+	bool contains(const glm::ivec3& chunkPos) const { return get(chunkPos) != nullptr; }
+
+	// Returns the chunk that was in the slot, if any, so the caller can unload it
+	ChunkEntry insert(const glm::ivec3& chunkPos, Chunk* chunk);
+	bool erase(const glm::ivec3& chunkPos);
+	void clear();
+
+	// Rebuilds the render entry of a loaded chunk after its meshes changed
+	void updateRenderEntry(const glm::ivec3& chunkPos);
+
+	// Loaded chunks, densely packed in no particular order
+	const std::vector<ChunkEntry>& getEntries() const { return m_entries; }
+	// Same order as getEntries()
+	std::span<const RenderEntry> getRenderList() const { return m_renderList; }
+	size_t size() const { return m_entries.size(); }
+
+private:
+	struct Slot {
+		int chunkX = 0;
+		int chunkZ = 0;
+		Chunk* chunk = nullptr;
+		int entry = -1; // Index in m_entries, -1 when empty
+	};
+
+	std::array<Slot, SIZE * SIZE> m_slots;
+	std::vector<ChunkEntry> m_entries;
+	std::vector<RenderEntry> m_renderList;
+
+	static RenderEntry makeRenderEntry(Chunk& chunk);
+
+	static int slotIndex(int chunkX, int chunkZ) { return (chunkX & (SIZE - 1)) * SIZE + (chunkZ & (SIZE - 1)); }
+};
+
+} // namespace voxl
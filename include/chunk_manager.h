@@ -2,6 +2,20 @@
 
 #include "glm/glm.hpp"
 #include "cube.h"
+#include "chunk.h"
+#include "chunk_mesher.h"
+#include "thread_pool.h"
+#include "region_file.h"
+#include "chunk_grid.h"
+#include "chunk_streamer.h"
+#include "terrain_cache.h"
+#include "light_engine.h"
+#include <array>
+#include <filesystem>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
 #include <unordered_map>
 #include <unordered_set>
 
@@ -11,7 +25,11 @@ namespace std {
 	{
 		std::size_t operator()(const glm::ivec3& k) const
 		{
-			return std::hash<int>()(k.x) ^ std::hash<int>()(k.y) ^ std::hash<int>()(k.z);
+			// Each component gets its own odd multiplier so symmetric positions don't collide
+			uint64_t h = static_cast<uint32_t>(k.x) * 0x9E3779B97F4A7C15ull;
+			h ^= static_cast<uint32_t>(k.y) * 0xC2B2AE3D27D4EB4Full;
+			h ^= static_cast<uint32_t>(k.z) * 0x165667B19E3779F9ull;
+			return static_cast<std::size_t>(h ^ (h >> 32));
 		}
 	};
 } // namespace std
@@ -21,31 +39,272 @@ namespace voxl
 
 class Chunk;
 
+struct ChunkMemoryStats {
+	size_t chunkCount = 0;
+	size_t sectionCount = 0;
+	size_t uniformSectionCount = 0;
+	size_t voxelBytes = 0;
+	size_t denseBytes = 0; // Size the same chunks would take as flat BlockType arrays
+	size_t lightBytes = 0;
+};
+
+struct ChunkMeshStats {
+	size_t faceCount = 0; // Quads the naive mesher would emit
+	size_t quadCount = 0; // Quads actually emitted
+	size_t meshedSectionCount = 0;
+	size_t skippedSectionCount = 0; // Empty or enclosed sections that were never meshed
+};
+
+struct ChunkStorageStats {
+	size_t loadedCount = 0;    // Chunks read back from region files
+	size_t generatedCount = 0; // Chunks built from noise
+	size_t savedCount = 0;
+	size_t savedBytes = 0; // Encoded size of the chunks saved, without sector padding
+	double saveMs = 0.0;
+};
+
+struct ChunkEditStats {
+	size_t editCount = 0;
+	size_t remeshedSectionCount = 0; // Sections queued by all edits so far
+	size_t lastEditSectionCount = 0;
+	double lastEditMeshMs = 0.0; // Snapshot, build and upload time of the sections the last edit dirtied
+	double lastEditLightMs = 0.0;
+};
+
+struct ChunkCacheStats {
+	size_t hits = 0;   // Chunks brought back into view from the cache
+	size_t misses = 0; // Chunks that had to be loaded from disk or generated
+	size_t meshEvictions = 0;
+	size_t chunkEvictions = 0;
+	size_t cachedChunkCount = 0; // Out of view chunks still in memory
+	size_t usedBytes = 0;
+	size_t budgetBytes = 0;
+};
+
+struct ChunkStageStats {
+	std::array<size_t, CHUNK_STAGE_COUNT> completedCount = {}; // Times each stage ran
+	std::array<double, CHUNK_STAGE_COUNT> totalMs = {};        // Worker time, mesh time is the section builds
+	std::array<size_t, CHUNK_STAGE_COUNT> chunkCount = {};     // Loaded chunks currently at each stage
+	size_t generatingCount = 0;                                // Chunks on the workers
+	size_t pendingWriteCount = 0;                              // Decoration blocks waiting for their chunk
+};
+
 class ChunkManager
 {
 public:
-	static const int LOAD_RADIUS = 8;
+	// Chunks on the outer ring of the load radius stop at Decorated and the next ring at Lit,
+	// they are only there so the chunks inside have finished neighbors to light and mesh against
+	static const int LOAD_RADIUS = 10;
+	static const int MESH_RADIUS = LOAD_RADIUS - 2;
+	static const int UNLOAD_RADIUS = LOAD_RADIUS + 2; // Hysteresis, chunks stay loaded a little past the load radius
+	static_assert(ChunkGrid::SIZE > 2 * UNLOAD_RADIUS + 1, "loaded chunks must not share grid slots");
+	static const size_t DEFAULT_MEMORY_BUDGET = 256 * 1024 * 1024;
 
-	ChunkManager();
+	// Main thread time spent per frame on each streaming stage, at least one item always goes through
+	static constexpr double LOAD_BUDGET_MS = 4.0;
+	static constexpr double MESH_SUBMIT_BUDGET_MS = 2.0;
+	static constexpr double UPLOAD_BUDGET_MS = 2.0;
+	static constexpr double STAGE_BUDGET_MS = 4.0; // Mostly lighting
+
+	static const uint32_t DEFAULT_SEED = 1337;
+
+	// Chunks are persisted in region files under worldPath, an empty path keeps the world in memory only.
+	// A world on disk keeps the seed it was created with, seed only applies to new worlds.
+	explicit ChunkManager(const std::string& worldPath = "", uint32_t seed = DEFAULT_SEED);
 	~ChunkManager();
 
+	// Streams chunks in and out around the player within the frame budgets.
+	// Loading is nearest first, favoring what is in front of viewDirection.
+	void updateChunks(glm::vec3 playerPosition, glm::vec3 viewDirection = glm::vec3(0.0f));
+
+	// Loads every chunk in range right away, ignoring the budgets, for headless tools
 	void loadChunks(glm::vec3 playerPosition);
-	void updateChunks(glm::vec3 playerPosition);
-	void unloadChunks(glm::vec3 playerPosition);
 
+	// True once the chunk holding position is meshed. The world streams in over the first frames,
+	// the player waits for the ground under them.
+	bool isReady(const glm::vec3& position) const { return isMeshed(getPlayerChunk(position)); }
+
+	// Generates every chunk of the rectangle [minChunk, maxChunk] in chunk coordinates that is not
+	// on disk yet, and saves it without keeping it loaded. Blocks until done, for headless tools.
+	void pregenerate(const glm::ivec3& minChunk, const glm::ivec3& maxChunk);
+	size_t getWorkerCount() const { return m_workers.getThreadCount(); }
+
+	size_t getPendingLoadCount() const { return m_streamer.getPendingCount() + m_generating.size(); }
+	size_t getPendingMeshCount() const { return m_updateList.size() + m_workers.getPendingCount(); }
+
+	// Takes ownership of a decorated chunk. It is lit and meshed on later updates, once its
+	// neighbors have caught up.
+	void addChunk(const glm::ivec3& chunkPos, Chunk* chunk);
+
+	// Furthest stage a loaded chunk is taken to at its distance from the player
+	ChunkStage getTargetStage(const glm::ivec3& chunkPos) const;
+	ChunkStageStats getStageStats() const;
+
+	// Chunk containing the block at world position (x, y, z)
 	Chunk* getChunk(float x, float y, float z) const;
-	std::unordered_map<glm::ivec3, Chunk*> getChunks() const { return m_chunks; }
+	Chunk* getChunk(const glm::ivec3& chunkPos) const { return m_chunks.get(chunkPos); }
+	const std::vector<ChunkEntry>& getChunks() const { return m_chunks.getEntries(); }
+	// Draw data of the loaded chunks, kept up to date as chunks load, unload and get remeshed
+	std::span<const RenderEntry> getRenderList() const { return m_chunks.getRenderList(); }
 
-	void updateChunk(Chunk* chunk);
+	// Records an edit of the block at localPos. On the next update only the sections that can
+	// see it are remeshed, neighbor chunks only when the block is on their shared border.
+	void markBlockDirty(Chunk* chunk, const glm::ivec3& localPos);
+	ChunkEditStats getEditStats() const { return m_editStats; }
 
 	BlockType getBlockType(float x, float y, float z) const;
 	bool isSolidBlock(float x, float y, float z) const;
 
+	// Writes every chunk changed since it was last saved, and the decorations still waiting for their chunk
+	void saveChunks();
+
+	ChunkMemoryStats getMemoryStats() const;
+	ChunkMeshStats getMeshStats() const;
+	ChunkStorageStats getStorageStats() const { return m_storageStats; }
+	ChunkCacheStats getCacheStats() const;
+
+	// Voxel and mesh bytes allowed for all chunks, loaded or cached. Out of view chunks past the
+	// budget lose their meshes first, then their voxels, least recently used first.
+	void setMemoryBudget(size_t bytes) { m_memoryBudget = bytes; }
+	size_t getMemoryBudget() const { return m_memoryBudget; }
+
+	uint32_t getSeed() const { return m_seed; }
+	// Biomes and surface heights of the world, also for spawn and map queries
+	TerrainCache& getTerrain() { return m_terrain; }
+	const TerrainCache& getTerrain() const { return m_terrain; }
+
+	MeshingMode getMeshingMode() const { return m_meshingMode; }
+	void setMeshingMode(MeshingMode mode);
+
 private:
-	std::unordered_map<glm::ivec3, Chunk*> m_chunks;
+	// Chunks within the load radius. Everything in memory, loaded or not, is also in m_chunksCache.
+	ChunkGrid m_chunks;
 
+	// Sections waiting for a remesh, keyed by (chunk x, section index, chunk z)
 	std::unordered_set<glm::ivec3> m_updateList;
 
+	// Edited blocks in world block coordinates, turned into dirty sections once per update
+	std::vector<glm::ivec3> m_dirtyBlocks;
+	// Sections of the latest edits whose new mesh hasn't been uploaded yet, same keys as m_updateList
+	std::unordered_set<glm::ivec3> m_editSections;
+	ChunkEditStats m_editStats;
+
+	// Meshes built by the workers, waiting for upload on the GL thread
+	struct CompletedMesh {
+		glm::ivec3 chunkPos;
+		int section;
+		unsigned int revision;
+		double buildMs;
+		ChunkMeshData data;
+	};
+	std::vector<CompletedMesh> m_completedMeshes;
+	std::mutex m_completedMutex;
+	// Mesh revisions come from one counter for all chunks. A chunk evicted and loaded again
+	// starts over at 0, a per-chunk count would let it match a result requested before eviction.
+	unsigned int m_meshRevision = 0;
+
 	std::unordered_map<glm::ivec3, Chunk*> m_chunksCache;
+
+	// Cached chunks out of view, least recently used first
+	std::list<glm::ivec3> m_unloadedChunks;
+	std::unordered_map<glm::ivec3, std::list<glm::ivec3>::iterator> m_unloadedPositions;
+
+	size_t m_memoryBudget = DEFAULT_MEMORY_BUDGET;
+	// Voxel and mesh bytes of the cached chunks, kept up to date as they change
+	size_t m_cacheBytes = 0;
+	ChunkCacheStats m_cacheStats;
+
+	MeshingMode m_meshingMode = MeshingMode::Greedy;
+
+	// Chunks generated by the workers, waiting to be added on the main thread
+	struct GeneratedChunk {
+		glm::ivec3 chunkPos;
+		Chunk* chunk;
+		std::array<double, CHUNK_STAGE_COUNT> stageMs;
+	};
+	std::vector<GeneratedChunk> m_generatedChunks;
+	std::mutex m_generatedMutex;
+	std::unordered_set<glm::ivec3> m_generating;
+
+	// Blocks decorations placed in chunks that are not in memory yet, keyed by chunk position.
+	// Saved with the world, so a tree on the border of a chunk generated later is still whole.
+	std::unordered_map<glm::ivec3, std::vector<DecorationWrite>> m_pendingWrites;
+	// Chunks whose writes already went out, saved with the pending writes. A chunk generated again
+	// after eviction must not send them twice, or blocks removed from its neighbors grow back.
+	std::unordered_set<glm::ivec3> m_decoratedChunks;
+
+	// Loaded chunks that may be able to advance a stage, because they or a neighbor changed
+	std::unordered_set<glm::ivec3> m_stageDirty;
+	ChunkStageStats m_stageStats;
+
+	uint32_t m_seed;
+	TerrainCache m_terrain;
+	LightEngine m_light{ *this };
+
+	// Open region files, keyed by region position
+	std::filesystem::path m_worldPath;
+	std::unordered_map<glm::ivec3, std::unique_ptr<RegionFile>> m_regions;
+	ChunkStorageStats m_storageStats;
+
+	// Declared last so the workers are joined before the members they write to are destroyed
+	ThreadPool m_workers;
+
+	ChunkStreamer m_streamer{ LOAD_RADIUS, UNLOAD_RADIUS };
+
+	static int toChunkCoord(int block) { return (block >= 0 ? block : block - (Chunk::CHUNK_SIZE - 1)) / Chunk::CHUNK_SIZE; }
+
+	glm::ivec3 getPlayerChunk(const glm::vec3& playerPosition) const;
+	void loadOrGenerateChunk(const glm::ivec3& chunkPos);
+	void submitGenerateJob(const glm::ivec3& chunkPos);
+	void collectGeneratedChunks();
+	// Bookkeeping shared by every generated chunk before it is placed
+	void finishGeneratedChunk(const GeneratedChunk& result);
+
+	// Applies the writes of a newly decorated chunk to the chunks in memory, queues the rest.
+	// Only the first time the chunk is generated, the writes are dropped after that.
+	void distributeDecorationWrites(const glm::ivec3& chunkPos, Chunk& chunk);
+	void applyPendingWrites(const glm::ivec3& chunkPos, Chunk& chunk);
+	void loadPendingWrites();
+	void savePendingWrites() const;
+	void unloadChunks();
+	void markUnloaded(const glm::ivec3& chunkPos);
+
+	// Measures a cached chunk again and applies the difference to m_cacheBytes. Called wherever
+	// its voxels, light, received writes or meshes change, the cache is never summed as a whole.
+	void updateCacheBytes(Chunk& chunk);
+	// The cached chunks within one chunk of chunkPos, as far as a light update reaches
+	void updateCacheBytesAround(const glm::ivec3& chunkPos);
+	void enforceMemoryBudget();
+
+	// Reads the seed of an existing world, or records seed for a new world. Returns the seed to use.
+	static uint32_t loadOrSaveSeed(const std::filesystem::path& worldPath, uint32_t seed);
+	RegionFile* getRegion(const glm::ivec3& chunkPos);
+	bool loadChunk(const glm::ivec3& chunkPos, Chunk& chunk);
+	void saveChunk(const glm::ivec3& chunkPos, Chunk& chunk);
+
+	// Stage scheduling. A chunk needs its 8 neighbors at Decorated to be lit and at Lit to be
+	// meshed, so chunks advance in waves from the player outwards as the neighbors arrive.
+	static ChunkStage getRequiredNeighborStage(ChunkStage stage);
+	bool hasNeighborsAt(const glm::ivec3& chunkPos, ChunkStage stage) const;
+	void markStageDirty(const glm::ivec3& chunkPos);
+	// Chunks left when the budget runs out wait for the next call, 0 runs everything
+	void advanceStages(double budgetMs = 0.0);
+	void runStage(const glm::ivec3& chunkPos, Chunk& chunk, ChunkStage stage);
+	bool isMeshed(const glm::ivec3& chunkPos) const;
+
+	void queueSections(const glm::ivec3& chunkPos);
+	void queueSection(const glm::ivec3& chunkPos, int section);
+
+	// True when the section cannot show any face: empty, or opaque and enclosed by opaque sections
+	bool isSectionHidden(const glm::ivec3& chunkPos, const Chunk& chunk, int section) const;
+
+	// Adds the meshed sections that can show the block at world position block
+	void addBlockSections(const glm::ivec3& block, std::unordered_set<glm::ivec3>& sections) const;
+	// Adds the sections showing the voxels the last light updates changed
+	void addLightSections(std::unordered_set<glm::ivec3>& sections);
+	void flushDirtyBlocks();
+	void submitDirtySections();
+	void submitMeshJob(const glm::ivec3& chunkPos, Chunk* chunk, int section);
+	void uploadCompletedMeshes();
 };
 } // namespace voxl
\ No newline at end of file
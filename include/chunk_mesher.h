@@ -0,0 +1,99 @@
+#pragma once
+
+#include "chunk.h"
+#include "cube.h"
+#include "mesh.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace voxl
+{
+class ChunkManager;
+
+enum class MeshingMode {
+	Naive = 0, // One quad per visible face
+	Greedy     // Coplanar faces of the same type and light merged into rectangles
+};
+
+// CPU side mesh of a chunk, built without touching GL
+struct ChunkMeshData {
+	std::vector<ChunkVertex> vertices;
+	std::vector<unsigned int> indices;
+	std::vector<ChunkVertex> waterVertices;
+	std::vector<unsigned int> waterIndices;
+	std::vector<uint32_t> occlusionColumns; // Texels of the section's OcclusionMap, ChunkSnapshot::SIZE wide
+
+	int faceCount = 0; // Visible faces, i.e. quads the naive mesher would emit
+	int quadCount = 0;
+	bool skipped = false; // Section was empty or enclosed, the mesher never ran
+};
+
+// Immutable copy of one chunk section plus a one voxel border taken from the sections
+// around it. Meshing only reads the snapshot, so it can run on any thread while the world changes.
+class ChunkSnapshot {
+public:
+	static const int SIZE = ChunkSection::SIZE + 2;
+
+	// Border voxels of missing neighbors are filled with this solid placeholder so the
+	// faces facing them stay hidden until the neighbor loads and triggers a remesh.
+	// The top and bottom of the column are padded the same way.
+	static constexpr BlockType MISSING_NEIGHBOR = BlockType::Stone;
+
+	// Blocks are read through the manager, so the chunk has to be loaded in it
+	ChunkSnapshot(const Chunk& chunk, int section, const ChunkManager& chunkManager);
+
+	// Section local coordinates, valid from -1 to ChunkSection::SIZE inclusive
+	BlockType get(int x, int y, int z) const { return m_blocks[index(x, y, z)]; }
+	// Packed light, see LightSection. Dark where the blocks are padded.
+	uint8_t getLight(int x, int y, int z) const { return m_light[index(x, y, z)]; }
+
+	// Reference visibility test for one face, the mesher uses FaceMasks instead
+	bool isFaceVisible(int x, int y, int z, int direction, BlockType faceType) const;
+
+	// The SIZE contiguous blocks of a column, starting at y = -1
+	const BlockType* getColumn(int x, int z) const { return &m_blocks[index(x, -1, z)]; }
+
+	int getSection() const { return m_section; }
+
+private:
+	std::vector<BlockType> m_blocks;
+	std::vector<uint8_t> m_light;
+	int m_section;
+
+	static int index(int x, int y, int z) { return ((x + 1) * SIZE + (z + 1)) * SIZE + (y + 1); }
+
+	// Copies the light of the part of a chunk at horizontal offset (offsetX, offsetZ) that overlaps the snapshot
+	void copyLight(const Chunk* chunk, int offsetX, int offsetZ);
+};
+
+// Visible faces of a snapshot computed a whole column at a time. Each column is turned into
+// opacity bitmasks along y, faces then fall out of shifts and ANDs against the neighbor columns.
+class FaceMasks {
+public:
+	explicit FaceMasks(const ChunkSnapshot& snapshot);
+
+	// Bit y is set when the face of block (x, y, z) in that direction is visible
+	uint32_t get(int direction, int x, int z) const { return m_faces[direction][x][z]; }
+
+	int getFaceCount() const;
+
+	// Bit y + 1 is set when block (x, y, z) is opaque, snapshot coordinates from -1 to SIZE - 2
+	uint64_t getOpaqueColumn(int x, int z) const { return m_opaque[x + 1][z + 1]; }
+
+private:
+	uint32_t m_faces[6][ChunkSection::SIZE][ChunkSection::SIZE];
+	uint64_t m_opaque[ChunkSnapshot::SIZE][ChunkSnapshot::SIZE];
+};
+
+class ChunkMesher {
+public:
+	// Vertices are emitted in chunk local coordinates
+	static ChunkMeshData buildMesh(const ChunkSnapshot& snapshot, MeshingMode mode);
+
+private:
+	static void addFace(std::vector<ChunkVertex>& vertices, std::vector<unsigned int>& indices,
+		int x, int y, int z, int faceIndex, glm::ivec3 size, BlockType type, uint8_t light);
+};
+
+} // namespace voxl
@@ -0,0 +1,98 @@
+#pragma once
+
+#include "cube.h"
+#include <cstdint>
+#include <vector>
+
+namespace voxl
+{
+
+// Palette compressed storage for a SIZE^3 slab of a chunk column.
+// Each voxel stores a bit-packed index into a small palette of block types.
+// A section made of a single block type keeps no index data at all.
+class ChunkSection {
+public:
+	static const int SIZE = 32;
+	static const int VOLUME = SIZE * SIZE * SIZE;
+
+	ChunkSection(BlockType fill = BlockType::None);
+
+	BlockType get(int x, int y, int z) const
+	{
+		if (m_bitsPerEntry == 0) {
+			return m_palette[0];
+		}
+		return m_palette[readIndex(index(x, y, z))];
+	}
+
+	void set(int x, int y, int z, BlockType type);
+	void fill(BlockType type);
+
+	// Bulk copies of all VOLUME voxels, in index() order
+	void load(const BlockType* blocks);
+	void store(BlockType* blocks) const;
+
+	bool isUniform() const { return m_bitsPerEntry == 0; }
+	BlockType getUniformType() const { return m_palette[0]; }
+
+	// Occupancy, computed from the palette counts
+	int getCount(BlockType type) const;
+	int getOpaqueCount() const;
+	bool isEmpty() const { return isUniform() && m_palette[0] == BlockType::None; }
+	bool isFullyOpaque() const { return getOpaqueCount() == VOLUME; }
+
+	int getPaletteSize() const;
+	int getBitsPerEntry() const { return m_bitsPerEntry; }
+
+	// Bytes used by the palette and the packed indices
+	size_t getMemoryUsage() const;
+
+	// Voxels are laid out y first so a column is contiguous
+	static int index(int x, int y, int z) { return (x * SIZE + z) * SIZE + y; }
+
+private:
+	std::vector<BlockType> m_palette;
+	std::vector<uint32_t> m_counts; // Number of voxels using each palette entry
+	std::vector<uint64_t> m_data;
+	int m_bitsPerEntry;
+
+	uint32_t readIndex(int i) const
+	{
+		int perWord = 64 / m_bitsPerEntry;
+		int shift = (i % perWord) * m_bitsPerEntry;
+		return static_cast<uint32_t>((m_data[i / perWord] >> shift) & ((1ull << m_bitsPerEntry) - 1));
+	}
+
+	void writeIndex(int i, uint32_t value);
+	int findOrAddPalette(BlockType type);
+	void resize(int bitsPerEntry);
+};
+
+// Light levels of a SIZE^3 slab, one byte per voxel in ChunkSection::index() order with the
+// sky light in the high 4 bits and the block light in the low 4. A section lit the same
+// everywhere, like open sky or solid rock, keeps a single value until a voxel differs.
+class LightSection {
+public:
+	LightSection(uint8_t fill = 0) { this->fill(fill); }
+
+	uint8_t get(int x, int y, int z) const
+	{
+		return m_data.empty() ? m_fill : m_data[ChunkSection::index(x, y, z)];
+	}
+
+	void set(int x, int y, int z, uint8_t light);
+	void fill(uint8_t light);
+
+	bool isUniform() const { return m_data.empty(); }
+	size_t getMemoryUsage() const { return m_data.capacity(); }
+
+	static uint8_t pack(int sky, int block) { return static_cast<uint8_t>((sky << 4) | block); }
+	static int getSky(uint8_t light) { return light >> 4; }
+	static int getBlock(uint8_t light) { return light & 15; }
+
+private:
+	std::vector<uint8_t> m_data; // Empty while the section is uniform
+	uint8_t m_fill;
+};
+
+} // namespace voxl
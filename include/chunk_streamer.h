@@ -0,0 +1,57 @@
+#pragma once
+
+#include "glm/glm.hpp"
+#include "chunk_grid.h"
+#include <vector>
+
+namespace voxl
+{
+
+// Decides which chunks to load and unload around the player.
+// The load queue is only rebuilt when the player enters another chunk and is ordered nearest
+// first, with chunks in front of the camera pulled ahead. Chunks are unloaded past a radius
+// larger than the load radius so walking back and forth over a border doesn't thrash.
+class ChunkStreamer {
+public:
+	// How much the view direction shortens the distance of chunks straight ahead, 0 to 1
+	static constexpr float VIEW_WEIGHT = 0.5f;
+
+	ChunkStreamer(int loadRadius, int unloadRadius);
+
+	// Returns true when the player changed chunk, the caller should then unload far chunks
+	bool update(const glm::ivec3& playerChunk, const glm::vec3& viewDirection, const ChunkGrid& loaded);
+
+	bool hasPending() const { return !m_loadQueue.empty(); }
+	size_t getPendingCount() const { return m_loadQueue.size(); }
+	glm::ivec3 popNext();
+
+	bool isInLoadRange(const glm::ivec3& chunkPos) const { return getRingDistance(chunkPos) <= m_loadRadius; }
+	bool isOutOfRange(const glm::ivec3& chunkPos) const { return getRingDistance(chunkPos) > m_unloadRadius; }
+
+	// Lower is more urgent, used to order loading and meshing alike
+	float getPriority(const glm::ivec3& chunkPos) const;
+
+	// Chebyshev distance in chunks from the player chunk, the radii are measured in it
+	int getRingDistance(const glm::ivec3& chunkPos) const
+	{
+		return glm::max(glm::abs(chunkPos.x - m_playerChunk.x), glm::abs(chunkPos.z - m_playerChunk.z));
+	}
+
+	int getLoadRadius() const { return m_loadRadius; }
+	int getUnloadRadius() const { return m_unloadRadius; }
+
+private:
+	int m_loadRadius;
+	int m_unloadRadius;
+
+	bool m_hasPlayerChunk = false;
+	glm::ivec3 m_playerChunk = glm::ivec3(0);
+	glm::vec2 m_viewDirection = glm::vec2(0.0f);
+
+	// Sorted most urgent last so popping is cheap
+	std::vector<glm::ivec3> m_loadQueue;
+
+	void sortQueue();
+};
+
+} // namespace voxl
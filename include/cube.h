@@ -1,9 +1,10 @@
 #pragma once
 #include "mesh.h"
 #include <glm/glm.hpp>
+#include <cstdint>
 
 namespace voxl {
-	enum class BlockType {
+	enum class BlockType : uint8_t {
 		None = 0,
 		Grass,
 		Dirt,
@@ -12,8 +13,34 @@ namespace voxl {
 		Wood,
 		Water,
 		Leaves,
-		Snow
+		Snow,
+		Lamp
 	};
+	const int BLOCK_TYPE_COUNT = 10;
+
+	const int MAX_LIGHT_LEVEL = 15;
+
+	// Opaque blocks hide the faces behind them, air and water don't
+	inline bool isOpaque(BlockType type)
+	{
+		return type != BlockType::None && type != BlockType::Water;
+	}
+
+	// Light levels a block takes from light passing through it on top of the one lost per step,
+	// MAX_LIGHT_LEVEL stops light entirely
+	inline int getLightAbsorption(BlockType type)
+	{
+		if (type == BlockType::None) {
+			return 0;
+		}
+		return type == BlockType::Water ? 1 : MAX_LIGHT_LEVEL;
+	}
+
+	// Block light a block gives off
+	inline int getLightEmission(BlockType type)
+	{
+		return type == BlockType::Lamp ? MAX_LIGHT_LEVEL : 0;
+	}
 
 	class Cube {
 	public:
@@ -0,0 +1,70 @@
+#pragma once
+
+#include "glm/glm.hpp"
+#include "chunk.h"
+#include "world_view.h"
+#include <array>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace voxl
+{
+class ChunkManager;
+
+// Flood fill lighting with two channels per voxel, sky light and block light, each from 0 to
+// MAX_LIGHT_LEVEL. Light spreads to the 6 neighbors of a voxel and loses a level per step plus
+// what the block it enters absorbs. Sky light going straight down through air keeps its level,
+// so everything under open sky is fully lit.
+//
+// Only loaded chunks at the Lit stage or past it hold light. Light never flows into the others,
+// they pull it in from their lit neighbors when they get lit themselves. Light reaches at most
+// MAX_LIGHT_LEVEL blocks, so every update stays within the 3x3 chunks a WorldView keeps around
+// where it starts.
+// Runs on the main thread, between the stage updates and the edits.
+class LightEngine {
+public:
+	explicit LightEngine(const ChunkManager& chunkManager);
+
+	// Computes the light of a chunk that just reached the Lit stage. Light of lit neighbors flows
+	// in and the light of the chunk flows out into them.
+	void lightChunk(const glm::ivec3& chunkPos);
+
+	// Relights around a block whose type changed, in world block coordinates. Light the old block
+	// gave is taken back and the hole refilled from around it, so the work follows the light affected.
+	void updateBlock(const glm::ivec3& block);
+
+	// Voxels whose light changed in meshed chunks since the last call, in world block coordinates
+	std::vector<glm::ivec3> takeChangedBlocks() { return std::exchange(m_changed, {}); }
+
+private:
+	enum Channel { Sky = 0, Block = 1 };
+
+	struct RemovedLight {
+		glm::ivec3 pos;
+		int level;
+	};
+
+	// Lit chunks only, reset at the start of every call since chunks load and unload in between
+	WorldView m_view;
+
+	// Work queues reused between calls, indexed by Channel
+	std::array<std::vector<glm::ivec3>, 2> m_addQueues;
+	std::array<std::vector<RemovedLight>, 2> m_removeQueues;
+	std::vector<glm::ivec3> m_changed;
+
+	static int getLevel(uint8_t light, int channel)
+	{
+		return channel == Sky ? LightSection::getSky(light) : LightSection::getBlock(light);
+	}
+	static uint8_t withLevel(uint8_t light, int channel, int level)
+	{
+		return channel == Sky ? LightSection::pack(level, LightSection::getBlock(light)) : LightSection::pack(LightSection::getSky(light), level);
+	}
+
+	void setLevel(Chunk& chunk, const glm::ivec3& pos, int channel, int level);
+	void propagate(int channel);
+	void unpropagate(int channel);
+};
+
+} // namespace voxl
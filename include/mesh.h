@@ -1,26 +1,77 @@
 #pragma once
 
 #include <vector>
+#include <cstdint>
 #include <glm/glm.hpp>
 
 namespace voxl {
 
+// Packed chunk mesh vertex, 8 bytes.
+// position: x (6 bits) | y (8 bits) | z (6 bits) | face direction (3 bits)
+// data: block id (8 bits) | block light (4 bits) | sky light (4 bits)
+// Corner coordinates are chunk local and inclusive, so x/z go up to 32 and y up to 128.
+// The light is the packed LightSection byte of the voxel the face looks into. Ambient occlusion
+// is not in the vertex, the fragment shader reads it from the section's OcclusionMap.
+struct ChunkVertex {
+	uint32_t position;
+	uint32_t data;
+
+	static ChunkVertex pack(int x, int y, int z, int face, uint8_t blockId, uint8_t light)
+	{
+		ChunkVertex vertex;
+		vertex.position = static_cast<uint32_t>(x) | (static_cast<uint32_t>(y) << 6) |
+			(static_cast<uint32_t>(z) << 14) | (static_cast<uint32_t>(face) << 20);
+		vertex.data = blockId | (static_cast<uint32_t>(light) << 8);
+		return vertex;
+	}
+};
+
+// Opaque blocks of a section and its one block border, size x size texels of 64 bit masks along
+// y, split over the two channels of a GL_RG32UI texture. Bit y + 1 of texel (x + 1, z + 1) is
+// block (x, y, z). The fragment shader computes the ambient occlusion of chunk faces from it.
+class OcclusionMap {
+
+public:
+	// columns holds the low and high 32 bits of each mask, texel (x, z) at 2 * (z * size + x)
+	OcclusionMap(const std::vector<uint32_t>& columns, int size);
+	~OcclusionMap();
+
+	OcclusionMap(const OcclusionMap&) = delete;
+	OcclusionMap& operator=(const OcclusionMap&) = delete;
+
+	unsigned int texture = 0;
+	size_t gpuBytes = 0;
+
+};
+
 class Mesh {
 
 public:
 	Mesh();
 	Mesh(std::vector<glm::vec3> vertices, std::vector<glm::vec3> normals, std::vector<unsigned int> indices, std::vector<glm::vec4> colors);
+	Mesh(std::vector<ChunkVertex> vertices, std::vector<unsigned int> indices);
 	~Mesh();
 
-	unsigned int VAO, VBO, EBO, NBO, CBO;
+	unsigned int VAO = 0, VBO = 0, EBO = 0, NBO = 0, CBO = 0;
 
 	std::vector<glm::vec3> vertices;
 	std::vector<glm::vec3> normals;
 	std::vector<glm::vec4> colors;
 	std::vector<unsigned int> indices;
+	std::vector<ChunkVertex> packedVertices;
+
+	// Indices drawn and bytes held by the GL buffers, still known once the CPU copies are gone
+	unsigned int indexCount = 0;
+	size_t gpuBytes = 0;
+
+	bool isPacked = false;
 
 	void generateBuffers();
 
+	// CPU copies still held plus the GL buffers. Packed meshes free their copies after the upload,
+	// so they only count the GL buffers.
+	size_t getMemoryUsage() const;
+
 	void setColors(std::vector<glm::vec4> colors);
 
 };
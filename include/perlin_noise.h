@@ -0,0 +1,24 @@
+#pragma once
+
+namespace voxl
+{
+
+// 2D Perlin noise evaluated over a whole grid of samples at once. Values are bit for bit those of
+// fnlGetNoise2D with FNL_NOISE_PERLIN and no fractal, at the same seed and frequency.
+// Rows are computed several samples at a time with AVX2 or SSE2 when the build targets them.
+class PerlinNoise2D {
+public:
+	PerlinNoise2D(int seed, float frequency) : m_seed(seed), m_frequency(frequency) {}
+
+	// Single sample at integer position (x, z), for lookups outside a grid
+	float get(int x, int z) const;
+
+	// out[i * countZ + j] is the noise at (originX + i, originZ + j)
+	void generate(int originX, int originZ, int countX, int countZ, float* out) const;
+
+private:
+	int m_seed;
+	float m_frequency;
+};
+
+} // namespace voxl
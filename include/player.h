@@ -40,7 +40,8 @@ public:
         BlockType::Dirt,
         BlockType::Stone,
         BlockType::Sand,
-        BlockType::Wood
+        BlockType::Wood,
+        BlockType::Lamp
     };
 
     static void scroll_callback(GLFWwindow* window, double xoffset, double yoffset) {
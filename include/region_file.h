@@ -0,0 +1,67 @@
+#pragma once
+
+#include "glm/glm.hpp"
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <vector>
+
+namespace voxl
+{
+class Chunk;
+
+// On-disk storage for a REGION_SIZE x REGION_SIZE group of chunk columns.
+//
+// Layout, all integers little endian:
+//   header   magic "VXLR", format version, region size, reserved
+//   table    REGION_SIZE^2 entries of (first sector, byte size), zero when the chunk is absent
+//   payload  sector aligned chunk records, each one run length encoded section after another
+//
+// A rewritten chunk keeps its sectors when it still fits and moves to the end of the file otherwise.
+class RegionFile {
+public:
+	static const int REGION_SIZE = 32;
+	static const uint32_t VERSION = 1;
+	static const uint32_t SECTOR_SIZE = 4096;
+
+	// Opens the file, creating it if needed. A file with another version is left untouched and
+	// treated as empty so the chunks are regenerated.
+	explicit RegionFile(const std::filesystem::path& path);
+	~RegionFile();
+
+	RegionFile(const RegionFile&) = delete;
+	RegionFile& operator=(const RegionFile&) = delete;
+
+	bool isOpen() const { return m_file.is_open(); }
+
+	// chunkPos is in chunk coordinates, anywhere inside this region
+	bool hasChunk(const glm::ivec3& chunkPos) const;
+	// Encoded size of the chunk in bytes, 0 when it is not in the file
+	uint32_t getChunkSize(const glm::ivec3& chunkPos) const;
+	bool readChunk(const glm::ivec3& chunkPos, Chunk& chunk);
+	bool writeChunk(const glm::ivec3& chunkPos, const Chunk& chunk);
+
+	static glm::ivec3 getRegionPos(const glm::ivec3& chunkPos);
+	static std::string getFileName(const glm::ivec3& regionPos);
+
+private:
+	struct TableEntry {
+		uint32_t sector = 0;
+		uint32_t size = 0;
+	};
+
+	std::fstream m_file;
+	std::vector<TableEntry> m_table;
+	uint32_t m_sectorCount = 0; // Sectors in use, including the header
+
+	static int getTableIndex(const glm::ivec3& chunkPos);
+	static uint32_t getSectorSpan(uint32_t size) { return (size + SECTOR_SIZE - 1) / SECTOR_SIZE; }
+
+	bool writeHeader();
+	bool writeTableEntry(int index);
+
+	static void encodeChunk(const Chunk& chunk, std::vector<uint8_t>& out);
+	static bool decodeChunk(const std::vector<uint8_t>& data, Chunk& chunk);
+};
+
+} // namespace voxl
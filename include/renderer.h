@@ -9,6 +9,7 @@
 #include <player.h>
 #include <chunk_manager.h>
 #include <chunk.h>
+#include <array>
 
 
 #define window_width 1920
@@ -24,7 +25,8 @@ namespace voxl {
         { BlockType::Wood, glm::vec3(0.83f, 0.69f, 0.415f)},
 		{ BlockType::Water, glm::vec3(0.0f, 0.0f, 1.0f) },
 		{ BlockType::Leaves, glm::vec3(0.5f, 1.0f, 0.0f) },
-        { BlockType::Snow, glm::vec3(2.0f, 2.0f, 2.0f) }
+        { BlockType::Snow, glm::vec3(2.0f, 2.0f, 2.0f) },
+        { BlockType::Lamp, glm::vec3(1.0f, 0.85f, 0.5f) }
     };
 
     static const std::vector<glm::vec3> g_cubeVertices = {
@@ -106,6 +108,18 @@ namespace voxl {
     };
 
 
+static const int MAX_SHADOW_CASCADES = 4; // Matches the uniform arrays in default_frag.glsl
+
+// Sun shadows are cascaded: the view frustum up to distance is cut into cascadeCount slices, each
+// with its own shadow map of the same resolution, so texels are smallest near the camera.
+struct ShadowSettings {
+	int cascadeCount = 3; // 1 to MAX_SHADOW_CASCADES
+	int resolution = 2048; // Texels per side of each cascade
+	GLenum depthFormat = GL_DEPTH_COMPONENT24; // GL_DEPTH_COMPONENT16 halves the memory
+	float distance = 160.0f; // From the camera, nothing is shadowed past it
+	float splitLambda = 0.75f; // Blend of logarithmic (1) and even (0) split distances
+};
+
 class Renderer {
 public:
 	Renderer();
@@ -115,12 +129,12 @@ public:
 	void generateCubeMesh();
 	void initUI() const;
 
-	void setupUI(Player& player, const glm::vec3& blockPos);
+	void setupUI(Player& player, const ChunkManager& chunkManager, const glm::vec3& blockPos);
 
     void update(Player& player, const ChunkManager& chunkManager);
 
 	void renderCube(BlockType type, glm::vec3 position, glm::mat4 view, glm::mat4 projection);
-	void renderChunk(Chunk& chunk, glm::mat4 view, glm::mat4 projection, bool transparent);
+	void renderChunk(const RenderEntry& entry, bool transparent);
     void renderChunks(const ChunkManager& chunkManager, glm::mat4 view, glm::mat4 projection);
 	void renderHighlight(glm::vec3 block, glm::mat4 view, glm::mat4 projection);
 
@@ -135,11 +149,26 @@ public:
 
     void updateLighting(const glm::vec3& lightTarget, float deltaTime);
 
+	// Reallocates the shadow maps, the settings take effect from the next frame
+	void setShadowSettings(const ShadowSettings& settings);
+	const ShadowSettings& getShadowSettings() const { return m_shadowSettings; }
+	size_t getShadowMapBytes() const;
+
     GLFWwindow* window;
     
 
 private:
-    const unsigned int SHADOW_WIDTH = 4096*4, SHADOW_HEIGHT = 4096*4;
+	// Casters between the light and a cascade are kept up to this far past its bounds
+	static constexpr float SHADOW_CASTER_MARGIN = 256.0f;
+
+	struct ShadowCascade {
+		glm::mat4 lightView; // Rotation only, shared by every cascade
+		glm::mat4 lightSpaceMatrix;
+		glm::vec3 boundsMin; // Light view space box the cascade renders
+		glm::vec3 boundsMax;
+		float splitDistance = 0.0f; // View depth where the next cascade takes over
+		float texelSize = 0.0f; // World units per shadow map texel
+	};
 
 	std::unique_ptr<Mesh> m_cubeMesh;
     std::unique_ptr<Shader> m_defaultShader;
@@ -152,18 +181,15 @@ private:
 
 	unsigned int m_crosshairTexture;
 
-	unsigned int m_depthMapFBO;
-	unsigned int m_depthMap;
+	ShadowSettings m_shadowSettings;
+	std::array<ShadowCascade, MAX_SHADOW_CASCADES> m_cascades;
+	unsigned int m_depthMapFBO = 0;
+	unsigned int m_depthMap = 0; // Depth texture array, a layer per cascade
 
-	glm::mat4 m_lightProjection;
-	glm::mat4 m_lightView;
-    glm::mat4 m_lightSpaceMatrix;
-	glm::vec3 m_lightPos;
 	glm::vec3 m_lightDir;
 
     float m_lightAzimuth = 0.0f;  
     float m_lightElevation = glm::radians(45.0f);
-	float m_lightDistance = 100.0f;
 
 	// Day/Night cycle parameters
     float m_cycleDuration; // Duration of a day/night cycle in seconds
@@ -174,6 +200,10 @@ private:
 
 	void initDepthMap();
 	void initLighting();
+	// Fits every cascade around its slice of the camera frustum, in texel steps so shadow edges
+	// don't shimmer as the camera moves
+	void updateCascades(const Camera& camera);
+	static bool isInCascade(const RenderEntry& entry, const ShadowCascade& cascade);
 
 	bool isDay();
 
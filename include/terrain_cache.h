@@ -0,0 +1,114 @@
+#pragma once
+
+#include "chunk.h"
+#include "perlin_noise.h"
+#include <array>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+struct fnl_state;
+
+namespace voxl
+{
+
+struct TerrainCacheStats {
+	size_t hits = 0;
+	size_t misses = 0; // Tiles computed, including ones evicted and computed again
+	size_t evictions = 0;
+	size_t tileCount = 0;
+	size_t tileLimit = 0;
+};
+
+// Large scale terrain shape shared by every chunk: biome noise and surface height sampled every
+// SAMPLE_STEP blocks over TILE_SIZE x TILE_SIZE tiles, interpolated in between. Biome noise changes
+// over kilometers, so chunks read it from here instead of evaluating it per column.
+// Tiles are computed on first use and the least recently used ones are dropped past the limit.
+// Safe to use from several threads at once.
+class TerrainCache {
+public:
+	static const int TILE_SIZE = 256; // Blocks, a multiple of the chunk size so a chunk never spans two tiles
+	static const int SAMPLE_STEP = 8;
+	static const int SAMPLES = TILE_SIZE / SAMPLE_STEP + 1; // Per side, including the far edge
+	static const size_t DEFAULT_TILE_LIMIT = 64;
+	static const int WATER_HEIGHT = 10; // Columns below this are flooded up to it
+
+	// Caves are carved where the cave noise is above the threshold, never below CAVE_MIN_HEIGHT.
+	// The threshold rises to CAVE_SURFACE_THRESHOLD over the top CAVE_SURFACE_DEPTH blocks of a
+	// column so only a few caves open up at the surface. Columns this close to the water height
+	// keep CAVE_COVER blocks over their caves so the water above them stays sealed.
+	static constexpr float CAVE_THRESHOLD = 0.55f;
+	static constexpr float CAVE_SURFACE_THRESHOLD = 0.8f;
+	static const int CAVE_SURFACE_DEPTH = 8;
+	static const int CAVE_MIN_HEIGHT = 3;
+	static const int CAVE_COVER = 4;
+
+	explicit TerrainCache(uint32_t seed, size_t tileLimit = DEFAULT_TILE_LIMIT);
+	~TerrainCache();
+
+	TerrainCache(const TerrainCache&) = delete;
+	TerrainCache& operator=(const TerrainCache&) = delete;
+
+	uint32_t getSeed() const { return m_seed; }
+
+	// Biome noise at block column (x, z), in [-1, 1]
+	float getBiomeValue(int x, int z);
+	// out[i * countZ + j] is the biome noise at (originX + i, originZ + j)
+	void getBiomeValues(int originX, int originZ, int countX, int countZ, float* out);
+
+	// Surface height interpolated from the samples, for views that don't need block accuracy
+	float getApproximateHeight(int x, int z);
+	// Height of the top terrain block of a column, exactly as generation places it
+	int getSurfaceHeight(int x, int z);
+
+	// 3D cave noise at block (x, y, z), in [-1, 1]. Chunks sample it on a coarse lattice.
+	float getCaveNoise(int x, int y, int z) const;
+
+	// Height noise of one biome, in [-1, 1]
+	const PerlinNoise2D& getHeightNoise(BiomeType biome) const { return m_heightNoise[static_cast<int>(biome)]; }
+
+	TerrainCacheStats getStats() const;
+	void setTileLimit(size_t tileLimit);
+
+	static BiomeBlends getBiomeBlends(float biomeValue);
+	// Terrain height of a column from its biomes and the height noise of each biome
+	static int getTerrainHeight(const BiomeBlends& blends, const std::array<float, BIOME_COUNT>& heightNoise);
+
+private:
+	struct Tile {
+		std::array<float, SAMPLES * SAMPLES> biome;
+		std::array<float, SAMPLES * SAMPLES> height;
+	};
+
+	uint32_t m_seed;
+	std::unique_ptr<fnl_state> m_biomeNoise;
+	std::unique_ptr<fnl_state> m_caveNoise;
+	std::vector<PerlinNoise2D> m_heightNoise; // Indexed by BiomeType
+
+	struct CachedTile {
+		std::unique_ptr<Tile> tile;
+		std::list<uint64_t>::iterator recent;
+	};
+
+	// Tiles keyed by tileKey(), most recently used at the front of m_recent
+	std::unordered_map<uint64_t, CachedTile> m_tiles;
+	std::list<uint64_t> m_recent;
+	size_t m_tileLimit;
+	TerrainCacheStats m_stats;
+	mutable std::mutex m_mutex;
+
+	// Call with m_mutex held. The pointer stays valid until the next call.
+	const Tile& getTile(int tileX, int tileZ);
+	std::unique_ptr<Tile> buildTile(int tileX, int tileZ) const;
+	void evictTiles();
+
+	static float interpolate(const std::array<float, SAMPLES * SAMPLES>& samples, int localX, int localZ);
+	static int toTileCoord(int block) { return block >> 8; }
+	static uint64_t tileKey(int tileX, int tileZ) { return (static_cast<uint64_t>(static_cast<uint32_t>(tileX)) << 32) | static_cast<uint32_t>(tileZ); }
+	static_assert((1 << 8) == TILE_SIZE, "toTileCoord assumes the tile size");
+};
+
+} // namespace voxl
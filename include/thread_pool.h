@@ -0,0 +1,45 @@
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+namespace voxl
+{
+
+// Fixed set of worker threads consuming a FIFO job queue
+class ThreadPool {
+public:
+	// threadCount 0 picks one thread per hardware core minus the main thread
+	ThreadPool(unsigned int threadCount = 0);
+	~ThreadPool();
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	void submit(std::function<void()> job);
+
+	// Blocks until the queue is empty and no job is running
+	void wait();
+
+	size_t getThreadCount() const { return m_workers.size(); }
+	size_t getPendingCount() const;
+
+private:
+	std::vector<std::thread> m_workers;
+	std::queue<std::function<void()>> m_jobs;
+
+	mutable std::mutex m_mutex;
+	std::condition_variable m_jobAvailable;
+	std::condition_variable m_idle;
+
+	size_t m_activeJobs = 0;
+	bool m_stopping = false;
+
+	void workerLoop();
+};
+
+} // namespace voxl
@@ -0,0 +1,82 @@
+#pragma once
+
+#include "glm/glm.hpp"
+#include "chunk.h"
+#include <array>
+
+namespace voxl
+{
+class ChunkManager;
+
+// Block queries in integer world coordinates for code that asks about many nearby blocks,
+// like collisions, raycasts and lighting. The 3x3 chunks around the last query are looked up
+// once and kept, so a query inside them is a shift, a mask and a section read.
+//
+// Holds raw chunk pointers: use it within a frame and don't keep it across updateChunks().
+class WorldView {
+public:
+	// Chunks before minStage are left out as if they were not loaded
+	explicit WorldView(const ChunkManager& chunkManager, ChunkStage minStage = ChunkStage::Empty);
+
+	// None outside the world height and in chunks that are not loaded
+	BlockType get(int x, int y, int z)
+	{
+		if (y < 0 || y >= Chunk::CHUNK_HEIGHT) {
+			return BlockType::None;
+		}
+		const Chunk* chunk = getChunk(x >> CHUNK_SHIFT, z >> CHUNK_SHIFT);
+		if (chunk == nullptr) {
+			return BlockType::None;
+		}
+		return chunk->getBlockType(x & CHUNK_MASK, y, z & CHUNK_MASK);
+	}
+	BlockType get(const glm::ivec3& pos) { return get(pos.x, pos.y, pos.z); }
+
+	bool isSolid(int x, int y, int z)
+	{
+		BlockType type = get(x, y, z);
+		return type != BlockType::None && type != BlockType::Water;
+	}
+	bool isOpaque(int x, int y, int z) { return voxl::isOpaque(get(x, y, z)); }
+
+	// Chunk holding world column (x, z), null when it is not loaded or before the minimum stage
+	Chunk* getChunkAt(int x, int z) { return getChunk(x >> CHUNK_SHIFT, z >> CHUNK_SHIFT); }
+
+	// Copies the blocks of the box [min, max], both inclusive, into out at
+	// ((x * sizeZ) + z) * sizeY + y from min, the layout of ChunkSnapshot. Blocks outside the
+	// world height and in chunks that are not loaded read as fill.
+	void readRegion(const glm::ivec3& min, const glm::ivec3& max, BlockType* out, BlockType fill = BlockType::None);
+
+	// Drops the cached chunks, for when the view is kept while chunks load or unload
+	void reset();
+
+private:
+	static const int CHUNK_SHIFT = 5;
+	static const int CHUNK_MASK = Chunk::CHUNK_SIZE - 1;
+	static_assert((1 << CHUNK_SHIFT) == Chunk::CHUNK_SIZE, "chunk size must match the shift");
+
+	const ChunkManager& m_chunkManager;
+	ChunkStage m_minStage;
+
+	// Chunks around (m_centerX, m_centerZ), indexed (dx + 1) * 3 + (dz + 1)
+	std::array<Chunk*, 9> m_neighborhood;
+	int m_centerX = 0;
+	int m_centerZ = 0;
+	bool m_valid = false;
+
+	Chunk* getChunk(int chunkX, int chunkZ)
+	{
+		int dx = chunkX - m_centerX;
+		int dz = chunkZ - m_centerZ;
+		if (!m_valid || dx < -1 || dx > 1 || dz < -1 || dz > 1) {
+			recenter(chunkX, chunkZ);
+			dx = 0;
+			dz = 0;
+		}
+		return m_neighborhood[(dx + 1) * 3 + (dz + 1)];
+	}
+
+	void recenter(int chunkX, int chunkZ);
+};
+
+} // namespace voxl
@@ -4,56 +4,107 @@ layout(location = 0) out vec4 FragColor;
 
 in vec4 normal;          
 in vec4 vertexColor;     
-in vec4 fragPosLightSpace; 
+in vec3 fragWorldPos;
+in float fragViewDepth;
 in vec3 lightDirection;
+in vec3 blockLighting;
+in vec3 localPos;
+flat in int faceDirection;
 
-uniform sampler2D shadowMap;
+const int MAX_CASCADES = 4; // Renderer's MAX_SHADOW_CASCADES
+
+uniform sampler2DArrayShadow shadowMap; // A layer per cascade
+uniform mat4 lightSpaceMatrices[MAX_CASCADES];
+uniform float cascadeSplits[MAX_CASCADES]; // View depth where each cascade ends
+uniform float cascadeTexelSizes[MAX_CASCADES]; // World units per texel
+uniform int cascadeCount = 1;
 uniform vec3 fogColor = vec3(0.0, 0.7, 1.0);
 uniform float fogStart = 100;
 uniform float fogEnd = 150;
 uniform bool useShadows = true;
 uniform bool isDay;
 
-float ShadowCalculation(vec4 fragPosLightSpace)
+// Opaque blocks of the section being drawn and its border, see OcclusionMap in mesh.h
+uniform usampler2D occlusionMap;
+uniform int sectionBaseY;
+
+// Brightness of a corner by ambient occlusion, from a crease to fully open
+const float occlusionCurve[4] = float[4](0.5, 0.68, 0.84, 1.0);
+
+// Section local block, valid from -1 to the section size
+bool isOpaque(ivec3 block)
 {
-    // Transform to normalized device coordinates
-    vec3 projCoords = fragPosLightSpace.xyz / fragPosLightSpace.w;
-    projCoords = projCoords * 0.5 + 0.5;
+    uvec2 column = texelFetch(occlusionMap, ivec2(block.x + 1, block.z + 1), 0).rg;
+    uint bit = uint(block.y + 1);
+    return ((bit < 32u ? column.r >> bit : column.g >> (bit - 32u)) & 1u) != 0u;
+}
 
-    // Check if fragment is outside the shadow map bounds
-    if (projCoords.x < 0.0 || projCoords.x > 1.0 || projCoords.y < 0.0 || projCoords.y > 1.0)
-        return 0.1;
+float cornerOcclusion(bool side1, bool side2, bool corner)
+{
+    return occlusionCurve[side1 && side2 ? 0 : 3 - (int(side1) + int(side2) + int(corner))];
+}
+
+// Corners of the face cell under the fragment, darkened by the blocks around the voxel in front
+// of it, blended across the cell. Per fragment so greedy quads need not split on occlusion.
+float AmbientOcclusion()
+{
+    int axis = faceDirection / 2;
+    int axisU = (axis + 1) % 3;
+    int axisV = (axis + 2) % 3;
+    ivec3 stepU = ivec3(0);
+    ivec3 stepV = ivec3(0);
+    stepU[axisU] = 1;
+    stepV[axisV] = 1;
 
-    float closestDepth = texture(shadowMap, projCoords.xy).r;
+    // Faces lie on whole coordinates along their normal, the cell spans them in the plane
+    vec3 pos = localPos - vec3(0.0, float(sectionBaseY), 0.0);
+    ivec3 front = clamp(ivec3(floor(pos)), ivec3(0), ivec3(31));
+    front[axis] = faceDirection % 2 == 1 ? int(round(pos[axis])) : int(round(pos[axis])) - 1;
+    float s = clamp(pos[axisU] - float(front[axisU]), 0.0, 1.0);
+    float t = clamp(pos[axisV] - float(front[axisV]), 0.0, 1.0);
 
-    float currentDepth = projCoords.z;
+    bool lowU = isOpaque(front - stepU);
+    bool highU = isOpaque(front + stepU);
+    bool lowV = isOpaque(front - stepV);
+    bool highV = isOpaque(front + stepV);
+    float corner00 = cornerOcclusion(lowU, lowV, isOpaque(front - stepU - stepV));
+    float corner10 = cornerOcclusion(highU, lowV, isOpaque(front + stepU - stepV));
+    float corner01 = cornerOcclusion(lowU, highV, isOpaque(front - stepU + stepV));
+    float corner11 = cornerOcclusion(highU, highV, isOpaque(front + stepU + stepV));
+    return mix(mix(corner00, corner10, s), mix(corner01, corner11, s), t);
+}
 
-    float bias = max(0.0075 * (1.0 - dot(normal.xyz, lightDirection)), 0.0001);
-    //float bias = 0.00005;
-//    float diffuseFactor = max(dot(normal.xyz, -lightDirection),0.0);
-//    float bias = mix(0.0,0.0,diffuseFactor);
+float ShadowCalculation()
+{
+    // Nearest cascade that covers the fragment
+    int cascade = 0;
+    while (cascade < cascadeCount && fragViewDepth > cascadeSplits[cascade])
+        cascade++;
+    if (cascade == cascadeCount)
+        return 0.1;
 
+    // Pushing the lookup out along the normal by a texel keeps surfaces from shadowing themselves
+    vec3 offsetPos = fragWorldPos + normal.xyz * cascadeTexelSizes[cascade];
+    vec3 projCoords = (lightSpaceMatrices[cascade] * vec4(offsetPos, 1.0)).xyz * 0.5 + 0.5;
 
-    // Percentage-Closer Filtering
-//     float shadow = 0.0;
-//     int samples = 2; 
-//     float texelSize = 1.0 / textureSize(shadowMap, 0).x;
-//    
-//     for (int x = -samples; x <= samples; x++)
-//     {
-//         for (int y = -samples; y <= samples; y++)
-//         {
-//             vec2 offset = vec2(x, y) * texelSize;
-//             float closestDepth = texture(shadowMap, projCoords.xy + offset).r;
-//             shadow += currentDepth > closestDepth + bias ? 0.75 : 0.1;
-//         }
-//     }
-//     shadow /= pow((samples * 2 + 1), 2);
+    // Check if fragment is outside the shadow map bounds
+    if (projCoords.x < 0.0 || projCoords.x > 1.0 || projCoords.y < 0.0 || projCoords.y > 1.0)
+        return 0.1;
 
-    // No PCF
-    float shadow = currentDepth > closestDepth ? 0.75 : 0.1;
+    // Percentage-Closer Filtering, each comparison lookup already filters 2x2 texels
+    vec2 texelSize = 1.0 / vec2(textureSize(shadowMap, 0).xy);
+    float lit = 0.0;
+    for (int x = 0; x < 2; x++)
+    {
+        for (int y = 0; y < 2; y++)
+        {
+            vec2 offset = (vec2(x, y) - 0.5) * texelSize;
+            lit += texture(shadowMap, vec4(projCoords.xy + offset, float(cascade), projCoords.z - 0.0001));
+        }
+    }
+    lit *= 0.25;
 
-    return shadow;
+    return mix(0.75, 0.1, lit);
 }
 
 void main()
@@ -66,7 +117,7 @@ void main()
         } else {
             // tmp fix for shadow acne on vertical faces
             if(dot(normal.xyz, lightDirection) > 0.01) {
-                float shadow = ShadowCalculation(fragPosLightSpace);
+                float shadow = ShadowCalculation();
                 finalColor = (1.0 - shadow) * vertexColor.rgb;
             } else {
                 finalColor = vertexColor.rgb;
@@ -78,6 +129,8 @@ void main()
     {
         finalColor = vertexColor.rgb * 0.9;
     }
+    finalColor += blockLighting;
+    finalColor *= AmbientOcclusion();
 
 //    float depth = gl_FragCoord.z / gl_FragCoord.w; 
 //    float fogFactor = clamp((fogEnd - depth) / (fogEnd - fogStart), 0.0, 1.0);
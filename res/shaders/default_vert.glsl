@@ -1,35 +1,62 @@
 #version 330 core
-layout(location = 0) in vec3 aPos;       
-layout(location = 1) in vec3 aNormal;    
-layout(location = 2) in vec4 aColor;     
+layout(location = 0) in uvec2 aPacked; // see ChunkVertex in mesh.h
 
 uniform mat4 model;            
 uniform mat4 view;             
 uniform mat4 projection;       
-uniform mat4 lightSpaceMatrix; 
 uniform vec3 lightDir;
 uniform vec3 ambientLight = vec3(0.25, 0.25, 0.25); 
 uniform vec3 lightColor = vec3(1.0, 1.0, 1.0);
+uniform vec4 blockColors[16]; // indexed by block id
+uniform vec3 blockLightColor = vec3(1.0, 0.8, 0.55);
+
+const vec3 faceNormals[6] = vec3[6](
+    vec3(-1.0, 0.0, 0.0), vec3(1.0, 0.0, 0.0),
+    vec3(0.0, -1.0, 0.0), vec3(0.0, 1.0, 0.0),
+    vec3(0.0, 0.0, -1.0), vec3(0.0, 0.0, 1.0)
+);
 
 out vec4 vertexColor;      
-out vec4 fragPosLightSpace;
+out vec3 fragWorldPos; // Shadow map lookups happen per fragment, by cascade
+out float fragViewDepth;
 out vec3 lightDirection;   
 out vec4 normal;
+out vec3 blockLighting; // Added after shadowing, light sources aren't blocked by the sun's shadows
+out vec3 localPos; // Chunk local, the fragment shader finds the voxels around it for ambient occlusion
+flat out int faceDirection;
+
+// Brightness of a light level, each level down is 80% of the one above
+float lightCurve(uint level)
+{
+    return pow(0.8, 15.0 - float(level));
+}
 
 void main()
 {
+    // Unpack the vertex
+    vec3 aPos = vec3(aPacked.x & 63u, (aPacked.x >> 6) & 255u, (aPacked.x >> 14) & 63u);
+    vec3 aNormal = faceNormals[(aPacked.x >> 20) & 7u];
+    vec4 aColor = blockColors[aPacked.y & 255u];
+    float skyLight = lightCurve((aPacked.y >> 12) & 15u);
+    float blockLight = lightCurve((aPacked.y >> 8) & 15u);
+
     // Transform the vertex position to clip space
-    gl_Position = projection * view * model * vec4(aPos, 1.0);
+    vec4 viewPos = view * model * vec4(aPos, 1.0);
+    gl_Position = projection * viewPos;
 
     normal = model * vec4(aNormal, 0.0);
 
     // Compute light
     vec3 worldPos = vec3(model * vec4(aPos, 1.0));
     float diff = max(dot(normal.xyz, normalize(lightDir)), 0.0);
-    vec3 lighting = (ambientLight + diff) * lightColor;
+    vec3 lighting = (ambientLight + diff) * lightColor * skyLight;
 
     // Pass to the fragment shader
     vertexColor = aColor * vec4(lighting, 1.0);
-    fragPosLightSpace = lightSpaceMatrix * vec4(worldPos, 1.0);
+    blockLighting = aColor.rgb * blockLightColor * blockLight;
+    localPos = aPos;
+    faceDirection = int((aPacked.x >> 20) & 7u);
+    fragWorldPos = worldPos;
+    fragViewDepth = -viewPos.z;
     lightDirection = normalize(lightDir);
 }
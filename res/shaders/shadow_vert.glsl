@@ -1,6 +1,6 @@
 #version 330 core
 
-layout(location = 0) in vec3 aPos; 
+layout(location = 0) in uvec2 aPacked; // see ChunkVertex in mesh.h
 
 uniform mat4 model;
 uniform mat4 lightSpaceMatrix;
@@ -9,6 +9,7 @@ out vec4 FragPosLightSpace;
 
 void main()
 {
+    vec3 aPos = vec3(aPacked.x & 63u, (aPacked.x >> 6) & 255u, (aPacked.x >> 14) & 63u);
     FragPosLightSpace = lightSpaceMatrix * model * vec4(aPos, 1.0);
     
     gl_Position = FragPosLightSpace;
@@ -22,7 +22,7 @@ glm::mat4 Camera::getViewMatrix() const
 
 glm::mat4 Camera::getProjectionMatrix() const
 {
-	return glm::perspective(glm::radians(60.0f), (float)m_width / (float)m_height, m_nearClippingPlane, m_farClippingPlane);
+	return glm::perspective(getFov(), getAspectRatio(), m_nearClippingPlane, m_farClippingPlane);
 }
 
 glm::vec3 Camera::getPosition() const
@@ -1,27 +1,136 @@
 #include "chunk.h"
+#include "chunk_mesher.h"
 #include "chunk_manager.h"
-#include "renderer.h"  
+#include "terrain_cache.h"
 #include "glm/glm.hpp"
 #include <array>
 #include <iostream>
 #include  <algorithm>
 
-#define FNL_IMPL
-#include "FastNoiseLite.h"
-#include <random>
-
 namespace voxl {
 
+const char* getStageName(ChunkStage stage)
+{
+	static const char* names[CHUNK_STAGE_COUNT] = { "empty", "terrain", "fluids", "decorated", "lit", "meshed" };
+	return names[static_cast<int>(stage)];
+}
+
+namespace {
+
+// splitmix64 finalizer, spreads nearby inputs over the whole range
+uint64_t mixBits(uint64_t value)
+{
+	value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9ull;
+	value = (value ^ (value >> 27)) * 0x94D049BB133111EBull;
+	return value ^ (value >> 31);
+}
+
+// Uniform in [0, 1). Taken from the raw engine output, the standard distributions
+// are allowed to differ between library implementations.
+float nextFloat(std::mt19937& random)
+{
+	return (random() >> 8) * (1.0f / 16777216.0f);
+}
+
+// Runs of one block type from the bottom of a column up, top excluded
+struct ColumnRun {
+    BlockType type;
+    int top;
+};
+const int MAX_COLUMN_RUNS = 4;
+
+// Blocks of a terrain column whose top block is at height, everything above it is air
+int getColumnRuns(BiomeType biome, int height, std::array<ColumnRun, MAX_COLUMN_RUNS>& runs)
+{
+    int count = 0;
+    auto add = [&](BlockType type, int top) {
+        top = std::min(top, height + 1);
+        if (top > (count > 0 ? runs[count - 1].top : 0)) {
+            runs[count++] = { type, top };
+        }
+    };
+
+    switch (biome) {
+    case BiomeType::Desert:
+        add(BlockType::Stone, height - 3);
+        add(BlockType::Sand, height + 1);
+        break;
+
+    case BiomeType::Plains:
+    case BiomeType::Forest:
+        add(BlockType::Stone, height - 5);
+        add(BlockType::Dirt, height - 1);
+        add(BlockType::Grass, height + 1);
+        break;
+
+    case BiomeType::Mountains:
+        // Soil below the rock band, snow above it
+        add(BlockType::Dirt, std::min(height - 3, 25));
+        add(BlockType::Grass, 25);
+        add(BlockType::Stone, 80);
+        add(BlockType::Snow, height + 1);
+        break;
+    }
+    return count;
+}
+
+// Cave noise sampled every CAVE_STEP_XZ x CAVE_STEP_Y x CAVE_STEP_XZ blocks, on a lattice aligned
+// to world coordinates so neighbor chunks sample the same points along their shared border
+const int CAVE_STEP_XZ = 4;
+const int CAVE_STEP_Y = 8;
+const int CAVE_LATTICE_XZ = Chunk::CHUNK_SIZE / CAVE_STEP_XZ + 1;
+const int CAVE_LATTICE_Y = Chunk::CHUNK_HEIGHT / CAVE_STEP_Y + 1;
+
+struct CaveLattice {
+    std::array<float, CAVE_LATTICE_XZ * CAVE_LATTICE_XZ * CAVE_LATTICE_Y> noise;
+    int countY = 0; // Lattice levels sampled, the ones above hold -1 and never carve
+
+    // Samples the levels up to the first one at or above top
+    void sample(const TerrainCache& terrain, int originX, int originZ, int top)
+    {
+        countY = std::min((top + CAVE_STEP_Y - 1) / CAVE_STEP_Y + 1, CAVE_LATTICE_Y);
+        for (int i = 0; i < CAVE_LATTICE_XZ; i++) {
+            for (int k = 0; k < CAVE_LATTICE_XZ; k++) {
+                float* column = &noise[(i * CAVE_LATTICE_XZ + k) * CAVE_LATTICE_Y];
+                for (int j = 0; j < countY; j++) {
+                    column[j] = terrain.getCaveNoise(originX + i * CAVE_STEP_XZ, j * CAVE_STEP_Y, originZ + k * CAVE_STEP_XZ);
+                }
+                std::fill(column + countY, column + CAVE_LATTICE_Y, -1.0f);
+            }
+        }
+    }
+
+    // Bilinear in x and z, the noise of every lattice level over the column at local (x, z)
+    void interpolateColumn(int x, int z, std::array<float, CAVE_LATTICE_Y>& out) const
+    {
+        int i = x / CAVE_STEP_XZ;
+        int k = z / CAVE_STEP_XZ;
+        float fx = static_cast<float>(x % CAVE_STEP_XZ) / CAVE_STEP_XZ;
+        float fz = static_cast<float>(z % CAVE_STEP_XZ) / CAVE_STEP_XZ;
+        const float* c00 = &noise[(i * CAVE_LATTICE_XZ + k) * CAVE_LATTICE_Y];
+        const float* c01 = c00 + CAVE_LATTICE_Y;
+        const float* c10 = c00 + CAVE_LATTICE_XZ * CAVE_LATTICE_Y;
+        const float* c11 = c10 + CAVE_LATTICE_Y;
+        for (int j = 0; j < countY; j++) {
+            float atX0 = c00[j] + fz * (c01[j] - c00[j]);
+            float atX1 = c10[j] + fz * (c11[j] - c10[j]);
+            out[j] = atX0 + fx * (atX1 - atX0);
+        }
+        std::fill(out.begin() + countY, out.end(), -1.0f);
+    }
+};
+
+} // namespace
+
 Chunk::Chunk(const Chunk* chunk)
 {
 	m_x = chunk->m_x;
 	m_y = chunk->m_y;
 	m_z = chunk->m_z;
 	m_chunkManager = chunk->m_chunkManager;
-	if (chunk->m_mesh)
-	{
-		m_mesh = std::make_unique<Mesh>(*chunk->m_mesh);
-	}
+	m_sections = chunk->m_sections;
+	m_light = chunk->m_light;
+	m_stage = chunk->m_stage;
 }
 
 Chunk::Chunk(int x, int y, int z, ChunkManager* chunkManager)
@@ -30,16 +139,6 @@ Chunk::Chunk(int x, int y, int z, ChunkManager* chunkManager)
 	m_y = y;
 	m_z = z;
 	m_chunkManager = chunkManager;
-    for (int x = 0; x < CHUNK_SIZE; x++)
-    {
-        for (int y = 0; y < CHUNK_HEIGHT; y++)
-        {
-            for (int z = 0; z < CHUNK_SIZE; z++)
-            {
-                cubes[x][y][z] = BlockType::None;
-            }
-        }
-    }
 }
 
 Chunk::~Chunk()
@@ -48,312 +147,275 @@ Chunk::~Chunk()
 
 void Chunk::setBlockType(int x, int y, int z, BlockType type)
 {
-	cubes[x][y][z] = type;
+	m_sections[y / ChunkSection::SIZE].set(x, y % ChunkSection::SIZE, z, type);
+	m_modified = true;
 }
 
-std::vector<BiomeBlend> Chunk::calculateBiomeWeights(fnl_state& biomeNoise, int x, int z) {
-    float biomeValue = fnlGetNoise2D(&biomeNoise, x, z);
-    biomeValue = (biomeValue + 1.0f) / 2.0f;
-
-    std::vector<BiomeBlend> blends;
-    if (biomeValue < 0.2f) {
-        blends.push_back({ BiomeType::Desert, 1.0f - biomeValue / 0.25f });
-        blends.push_back({ BiomeType::Plains, biomeValue / 0.25f });
-    }
-    else if (biomeValue < 0.5f) {
-        blends.push_back({ BiomeType::Plains, 1.0f - (biomeValue - 0.25f) / 0.25f });
-        blends.push_back({ BiomeType::Forest, (biomeValue - 0.25f) / 0.25f });
-    }
-    else if (biomeValue < 0.85f) {
-        blends.push_back({ BiomeType::Forest, 1.0f - (biomeValue - 0.5f) / 0.25f });
-        blends.push_back({ BiomeType::Mountains, (biomeValue - 0.5f) / 0.25f });
-    }
-    else {
-        blends.push_back({ BiomeType::Mountains, 1.0f });
-    }
+bool Chunk::applyDecorationWrite(const DecorationWrite& write)
+{
+	int x = write.x - m_x;
+	int z = write.z - m_z;
+	if (getBlockType(x, write.y, z) != BlockType::None) {
+		return false;
+	}
+	setBlockType(x, write.y, z, write.type);
+	m_receivedWrites.push_back(write);
+	return true;
+}
 
-    return blends;
+size_t Chunk::getMemoryUsage() const
+{
+	size_t bytes = 0;
+	for (const ChunkSection& section : m_sections) {
+		bytes += section.getMemoryUsage();
+	}
+	return bytes + getLightMemoryUsage() + m_receivedWrites.capacity() * sizeof(DecorationWrite);
 }
 
+size_t Chunk::getLightMemoryUsage() const
+{
+	size_t bytes = 0;
+	for (const LightSection& section : m_light) {
+		bytes += section.getMemoryUsage();
+	}
+	return bytes;
+}
 
-void Chunk::generate() {
-    const int WATER_HEIGHT = 10; // Minimum water level
+uint64_t Chunk::getChunkSeed(uint32_t worldSeed, int chunkX, int chunkZ)
+{
+	uint64_t h = mixBits(worldSeed);
+	h = mixBits(h ^ static_cast<uint32_t>(chunkX));
+	return mixBits(h ^ (static_cast<uint64_t>(static_cast<uint32_t>(chunkZ)) << 32));
+}
 
-    // Configure biome noise
-    fnl_state biomeNoise = fnlCreateState();
-    biomeNoise.noise_type = FNL_NOISE_OPENSIMPLEX2S;
-    biomeNoise.frequency = 0.0005f;
+void Chunk::generate(TerrainCache& terrain) {
+    generateTerrain(terrain);
+    generateFluids();
+    decorate(terrain);
+}
 
-    // Configure noise for each biome
-    std::unordered_map<BiomeType, fnl_state> biomeNoiseConfigs;
+void Chunk::generateTerrain(TerrainCache& terrain) {
+    m_generation = std::make_unique<GenerationData>();
 
-    fnl_state desertNoise = fnlCreateState();
-    desertNoise.noise_type = FNL_NOISE_PERLIN;
-    desertNoise.frequency = 0.02f;
-    biomeNoiseConfigs[BiomeType::Desert] = desertNoise;
+    // Noise stage: the biomes of every column from the shared terrain cache, then the height
+    // noise of each biome in use, a whole chunk at a time
+    std::array<float, CHUNK_SIZE * CHUNK_SIZE>& biomeValues = m_generation->biomeValues;
+    terrain.getBiomeValues(m_x, m_z, CHUNK_SIZE, CHUNK_SIZE, biomeValues.data());
 
-    fnl_state forestNoise = fnlCreateState();
-    forestNoise.noise_type = FNL_NOISE_PERLIN;
-    forestNoise.frequency = 0.01f;
-    biomeNoiseConfigs[BiomeType::Forest] = forestNoise;
+    std::array<BiomeBlends, CHUNK_SIZE * CHUNK_SIZE> columnBiomes;
+    std::array<bool, BIOME_COUNT> biomeUsed = {};
+    for (int i = 0; i < CHUNK_SIZE * CHUNK_SIZE; i++) {
+        columnBiomes[i] = TerrainCache::getBiomeBlends(biomeValues[i]);
+        for (const auto& blend : columnBiomes[i]) {
+            biomeUsed[static_cast<int>(blend.type)] = true;
+        }
+    }
 
-    fnl_state plainsNoise = fnlCreateState();
-    plainsNoise.noise_type = FNL_NOISE_PERLIN;
-    plainsNoise.frequency = 0.03f;
-    biomeNoiseConfigs[BiomeType::Plains] = plainsNoise;
+    std::array<std::array<float, CHUNK_SIZE * CHUNK_SIZE>, BIOME_COUNT> biomeHeightNoise;
+    for (int biome = 0; biome < BIOME_COUNT; biome++) {
+        if (biomeUsed[biome]) {
+            terrain.getHeightNoise(static_cast<BiomeType>(biome)).generate(m_x, m_z, CHUNK_SIZE, CHUNK_SIZE, biomeHeightNoise[biome].data());
+        }
+    }
 
-    fnl_state mountainsNoise = fnlCreateState();
-    mountainsNoise.noise_type = FNL_NOISE_PERLIN;
-    mountainsNoise.frequency = 0.018f;
-    biomeNoiseConfigs[BiomeType::Mountains] = mountainsNoise;
+    std::array<std::array<ColumnRun, MAX_COLUMN_RUNS>, CHUNK_SIZE * CHUNK_SIZE> columnRuns;
+    std::array<uint8_t, CHUNK_SIZE * CHUNK_SIZE> columnRunCounts;
+    int terrainTop = 0;
 
     for (int x = 0; x < CHUNK_SIZE; x++) {
         for (int z = 0; z < CHUNK_SIZE; z++) {
-            // Calculate biome weights for blending
-            std::vector<BiomeBlend> blends = calculateBiomeWeights(biomeNoise, m_x + x, m_z + z);
-
-            float blendedHeight = 0.0f;
-            float totalWeight = 0.0f;
+            const BiomeBlends& blends = columnBiomes[x * CHUNK_SIZE + z];
 
+            std::array<float, BIOME_COUNT> heightNoise = {};
             for (const auto& blend : blends) {
-                fnl_state& heightNoise = biomeNoiseConfigs[blend.type];
-                float noiseValue = fnlGetNoise2D(&heightNoise, m_x + x, m_z + z);
-                float biomeMaxHeight = (blend.type == BiomeType::Mountains) ? ((CHUNK_SIZE * 3) / 2) : (CHUNK_SIZE / 2);
-                blendedHeight += ((noiseValue + 1.0f) * biomeMaxHeight) * blend.weight;
-                totalWeight += blend.weight;
+                heightNoise[static_cast<int>(blend.type)] = biomeHeightNoise[static_cast<int>(blend.type)][x * CHUNK_SIZE + z];
             }
+            int maxHeight = TerrainCache::getTerrainHeight(blends, heightNoise);
+            m_generation->surfaceHeights[x * CHUNK_SIZE + z] = static_cast<uint8_t>(maxHeight);
 
-            // Calculate maxHeight based on blended result
-            int maxHeight = static_cast<int>(blendedHeight / totalWeight);
-            maxHeight = std::clamp(maxHeight, 1, CHUNK_HEIGHT - 1);
-
-            // Generate terrain blocks up to maxHeight
-            for (int y = 0; y <= maxHeight; y++) {
-                BlockType type = BlockType::None;
-
-                for (const auto& blend : blends) {
-                    float weight = blend.weight;
+            // The last blend decides the blocks of the column
+            int count = getColumnRuns((blends.end() - 1)->type, maxHeight, columnRuns[x * CHUNK_SIZE + z]);
+            columnRunCounts[x * CHUNK_SIZE + z] = static_cast<uint8_t>(count);
+            terrainTop = std::max(terrainTop, maxHeight + 1);
+        }
+    }
 
-                    switch (blend.type) {
-                    case BiomeType::Desert:
-                        type = (y < maxHeight - 3) ? BlockType::Stone : BlockType::Sand;
-                        break;
+    // Fill stage: each run is a single fill of a dense buffer, loaded into the sections in one
+    // pass. Columns are contiguous in section order, a run only splits where a section ends.
+    // Sections above the terrain stay empty.
+    const int sectionCount = (terrainTop + ChunkSection::SIZE - 1) / ChunkSection::SIZE;
+    std::vector<BlockType> blocks(static_cast<size_t>(ChunkSection::VOLUME) * sectionCount);
+    auto fillColumn = [&](int column, int bottom, int top, BlockType type) {
+        while (bottom < top) {
+            int section = bottom / ChunkSection::SIZE;
+            int end = std::min(top, (section + 1) * ChunkSection::SIZE);
+            BlockType* out = blocks.data() + section * ChunkSection::VOLUME + column * ChunkSection::SIZE;
+            std::fill(out + bottom % ChunkSection::SIZE, out + (end - 1) % ChunkSection::SIZE + 1, type);
+            bottom = end;
+        }
+    };
 
-                    case BiomeType::Plains:
-                        if (y < maxHeight - 5) {
-                            type = BlockType::Stone;
-                        }
-                        else if (y < maxHeight - 1) {
-                            type = BlockType::Dirt;
-                        }
-                        else {
-                            type = BlockType::Grass;
-                        }
-                        break;
+    CaveLattice caves;
+    caves.sample(terrain, m_x, m_z, terrainTop);
 
-                    case BiomeType::Forest:
-                        if (y < maxHeight - 5) {
-                            type = BlockType::Stone;
-                        }
-                        else if (y < maxHeight - 1) {
-                            type = BlockType::Dirt;
-                        }
-                        else {
-                            type = BlockType::Grass;
-                        }
-                        break;
+    std::array<float, CAVE_LATTICE_Y> caveColumn;
+    for (int column = 0; column < CHUNK_SIZE * CHUNK_SIZE; column++) {
+        int y = 0;
+        for (int i = 0; i < columnRunCounts[column]; i++) {
+            fillColumn(column, y, columnRuns[column][i].top, columnRuns[column][i].type);
+            y = columnRuns[column][i].top;
+        }
+        fillColumn(column, y, sectionCount * ChunkSection::SIZE, BlockType::None);
 
-                    case BiomeType::Mountains:
-                        if (y >= 25 && y < 80) {
-                            type = BlockType::Stone;
-                        }
-                        else if (y >= 80) {
-                            type = BlockType::Snow;
-                        }
-                        else if (y < maxHeight - 3) {
-                            type = BlockType::Dirt;
-                        }
-                        else {
-                            type = BlockType::Grass;
-                        }
-                        break;
-                    }
+        // Carve stage: a run of air wherever the interpolated cave noise is above the threshold
+        int height = m_generation->surfaceHeights[column];
+        int caveTop = height > TerrainCache::WATER_HEIGHT + TerrainCache::CAVE_COVER ? height : height - TerrainCache::CAVE_COVER;
+        if (caveTop < TerrainCache::CAVE_MIN_HEIGHT) {
+            continue;
+        }
+        caves.interpolateColumn(column / CHUNK_SIZE, column % CHUNK_SIZE, caveColumn);
+        for (int cell = 0; cell * CAVE_STEP_Y <= caveTop; cell++) {
+            float bottom = caveColumn[cell];
+            float top = caveColumn[cell + 1];
+            // Linear in between, nothing to carve when neither end is above the lowest threshold
+            if (std::max(bottom, top) <= TerrainCache::CAVE_THRESHOLD) {
+                continue;
+            }
+            int first = std::max(cell * CAVE_STEP_Y, TerrainCache::CAVE_MIN_HEIGHT);
+            int last = std::min((cell + 1) * CAVE_STEP_Y, caveTop + 1);
+            int runStart = -1;
+            for (int caveY = first; caveY <= last; caveY++) {
+                float depth = std::min(static_cast<float>(height - caveY) / TerrainCache::CAVE_SURFACE_DEPTH, 1.0f);
+                float threshold = TerrainCache::CAVE_SURFACE_THRESHOLD + depth * (TerrainCache::CAVE_THRESHOLD - TerrainCache::CAVE_SURFACE_THRESHOLD);
+                bool carve = caveY < last && bottom + (top - bottom) * (caveY - cell * CAVE_STEP_Y) * (1.0f / CAVE_STEP_Y) > threshold;
+                if (carve && runStart < 0) {
+                    runStart = caveY;
                 }
-
-                if (type != BlockType::None) {
-                    cubes[x][y][z] = type;
+                else if (!carve && runStart >= 0) {
+                    fillColumn(column, runStart, caveY, BlockType::None);
+                    runStart = -1;
                 }
             }
+        }
+    }
+
+    for (int section = 0; section < sectionCount; section++) {
+        m_sections[section].load(blocks.data() + section * ChunkSection::VOLUME);
+    }
+    m_stage = ChunkStage::Terrain;
+}
+
+void Chunk::generateFluids() {
+    const int WATER_HEIGHT = TerrainCache::WATER_HEIGHT;
+
+    for (int x = 0; x < CHUNK_SIZE; x++) {
+        for (int z = 0; z < CHUNK_SIZE; z++) {
+            int maxHeight = m_generation->surfaceHeights[x * CHUNK_SIZE + z];
 
             // Add water blocks if maxHeight is below WATER_HEIGHT
             if (maxHeight < WATER_HEIGHT) {
                 for (int y = maxHeight; y < WATER_HEIGHT; y++) {
-                    if (cubes[x][y][z] == BlockType::None) {
-                        cubes[x][y][z] = BlockType::Water;
+                    if (getBlockType(x, y, z) == BlockType::None) {
+                        setBlockType(x, y, z, BlockType::Water);
                     }
                 }
             }
+        }
+    }
+
+    m_stage = ChunkStage::Fluids;
+}
+
+void Chunk::decorate(TerrainCache& terrain) {
+    // Trees draw from a stream of their own chunk, never from shared state
+    uint64_t chunkSeed = getChunkSeed(terrain.getSeed(), m_x / CHUNK_SIZE, m_z / CHUNK_SIZE);
+    std::seed_seq seedSequence = { static_cast<uint32_t>(chunkSeed), static_cast<uint32_t>(chunkSeed >> 32) };
+    std::mt19937 random(seedSequence);
+
+    for (int x = 0; x < CHUNK_SIZE; x++) {
+        for (int z = 0; z < CHUNK_SIZE; z++) {
+            BiomeBlends blends = TerrainCache::getBiomeBlends(m_generation->biomeValues[x * CHUNK_SIZE + z]);
+            int maxHeight = m_generation->surfaceHeights[x * CHUNK_SIZE + z];
 
             // Place trees
             for (const auto& blend : blends) {
                 if ((blend.type == BiomeType::Forest || blend.type == BiomeType::Plains)) {
                     // Check conditions for placing a tree
-                    if (cubes[x][maxHeight][z] == BlockType::Grass &&
-                        (maxHeight < CHUNK_HEIGHT) && cubes[x][maxHeight + 1][z] == BlockType::None) {
+                    if (maxHeight + 1 < CHUNK_HEIGHT && getBlockType(x, maxHeight, z) == BlockType::Grass &&
+                        getBlockType(x, maxHeight + 1, z) == BlockType::None) {
                         float treeProbability = (blend.type == BiomeType::Forest) ? 0.0035f : 0.001f;
 
                         // Try placing a tree based on probability
-                        if (static_cast<float>(rand()) / RAND_MAX < treeProbability * blend.weight) {
-                            placeTree(x, maxHeight, z);
+                        if (nextFloat(random) < treeProbability * blend.weight) {
+                            placeTree(x, maxHeight, z, random);
                         }
                     }
                 }
             }
-
         }
     }
+
+    // The voxels are final, the generation inputs aren't needed anymore
+    m_generation.reset();
+    m_modified = false;
+    m_stage = ChunkStage::Decorated;
 }
 
 
 
-void Chunk::generateMesh() {
-    std::vector<glm::vec3> vertices;
-    std::vector<glm::vec3> normals;
-    std::vector<uint32_t> indices;
-    std::vector<glm::vec4> colors;
+void Chunk::uploadMesh(int section, ChunkMeshData data) {
+    SectionMesh& sectionMesh = m_sectionMeshes[section];
+    sectionMesh.faceCount = data.faceCount;
+    sectionMesh.quadCount = data.quadCount;
+    sectionMesh.skipped = data.skipped;
 
-	std::vector<glm::vec3> waterVertices;
-	std::vector<glm::vec3> waterNormals;
-	std::vector<uint32_t> waterIndices;
-	std::vector<glm::vec4> waterColors;
+    // Empty and hidden sections keep no GL objects at all
+	sectionMesh.mesh = data.indices.empty() ? nullptr : std::make_unique<Mesh>(std::move(data.vertices), std::move(data.indices));
+	sectionMesh.waterMesh = data.waterIndices.empty() ? nullptr : std::make_unique<Mesh>(std::move(data.waterVertices), std::move(data.waterIndices));
+	bool drawn = sectionMesh.mesh || sectionMesh.waterMesh;
+	sectionMesh.occlusionMap = drawn ? std::make_unique<OcclusionMap>(data.occlusionColumns, ChunkSnapshot::SIZE) : nullptr;
+}
 
-    for (int x = 0; x < CHUNK_SIZE; x++) {
-        for (int y = 0; y < CHUNK_HEIGHT; y++) {
-            for (int z = 0; z < CHUNK_SIZE; z++) {
-                if (cubes[x][y][z] != BlockType::None) {
-                    for (int direction = 0; direction < 6; direction++) {
-                        if (isFaceVisible(x, y, z, direction, cubes[x][y][z])) {
-							if (cubes[x][y][z] == BlockType::Water)
-							{
-								waterColors.push_back(glm::vec4(g_cubeColors.at(cubes[x][y][z]), 0.5f));
-								waterColors.push_back(glm::vec4(g_cubeColors.at(cubes[x][y][z]), 0.5f));
-								waterColors.push_back(glm::vec4(g_cubeColors.at(cubes[x][y][z]), 0.5f));
-								waterColors.push_back(glm::vec4(g_cubeColors.at(cubes[x][y][z]), 0.5f));
-								addFace(waterVertices, waterNormals, waterIndices, x, y, z, direction);
-							}
-							else
-							{
-								colors.push_back(glm::vec4(g_cubeColors.at(cubes[x][y][z]), 1.0f));
-								colors.push_back(glm::vec4(g_cubeColors.at(cubes[x][y][z]), 1.0f));
-								colors.push_back(glm::vec4(g_cubeColors.at(cubes[x][y][z]), 1.0f));
-								colors.push_back(glm::vec4(g_cubeColors.at(cubes[x][y][z]), 1.0f));
-								addFace(vertices, normals, indices, x, y, z, direction);
-							}
-                        }
-                    }
-                }
-            }
-        }
+size_t Chunk::getMeshMemoryUsage() const {
+    size_t bytes = 0;
+    for (const SectionMesh& sectionMesh : m_sectionMeshes) {
+        bytes += sectionMesh.mesh ? sectionMesh.mesh->getMemoryUsage() : 0;
+        bytes += sectionMesh.waterMesh ? sectionMesh.waterMesh->getMemoryUsage() : 0;
+        bytes += sectionMesh.occlusionMap ? sectionMesh.occlusionMap->gpuBytes : 0;
     }
-
-    // Create the actual mesh
-	m_mesh = std::make_unique<Mesh>(vertices, normals, indices, colors);
-	m_waterMesh = std::make_unique<Mesh>(waterVertices, waterNormals, waterIndices, waterColors);
+    return bytes;
 }
 
-void Chunk::addFace(std::vector<glm::vec3>& vertices, std::vector<glm::vec3>& normals, std::vector<uint32_t>& indices,
-    int x, int y, int z, int faceIndex) {
-    glm::vec3 v1, v2, v3, v4;
-    glm::vec3 normal;
-
-    switch (faceIndex) {
-    case 0: // Left face
-        v1 = glm::vec3(x, y, z + 1);
-        v2 = glm::vec3(x, y + 1, z + 1);
-        v3 = glm::vec3(x, y + 1,z);
-        v4 = glm::vec3(x, y, z);
-        normal = glm::vec3(-1.0f, 0.0f, 0.0f);
-        break;
-    case 1: // Right face
-        v1 = glm::vec3(x + 1, y, z);
-        v2 = glm::vec3(x + 1, y + 1, z);
-        v3 = glm::vec3(x + 1, y + 1, z + 1);
-        v4 = glm::vec3(x + 1, y, z + 1);
-        normal = glm::vec3(1.0f, 0.0f, 0.0f);
-        break;
-    case 2: // Bottom face
-        v1 = glm::vec3(x+1, y, z);
-        v2 = glm::vec3(x + 1, y, z+1);
-        v3 = glm::vec3(x, y, z + 1);
-        v4 = glm::vec3(x, y, z);
-        normal = glm::vec3(0.0f, -1.0f, 0.0f);
-        break;
-    case 3: // Top face
-        v1 = glm::vec3(x, y + 1, z+1);
-        v2 = glm::vec3(x + 1, y + 1, z+1);
-        v3 = glm::vec3(x + 1, y + 1, z);
-        v4 = glm::vec3(x, y + 1, z);
-        normal = glm::vec3(0.0f, 1.0f, 0.0f);
-        break;
-    case 4: // Back face
-        v1 = glm::vec3(x+1, y, z);
-        v2 = glm::vec3(x, y, z);
-        v3 = glm::vec3(x, y + 1, z);
-        v4 = glm::vec3(x+1, y + 1, z);
-        normal = glm::vec3(0.0f, 0.0f, -1.0f);
-        break;
-    case 5: // Front face
-        v1 = glm::vec3(x, y, z + 1);
-        v2 = glm::vec3(x + 1, y, z + 1);
-        v3 = glm::vec3(x + 1, y + 1, z + 1);
-        v4 = glm::vec3(x, y + 1, z + 1);
-        normal = glm::vec3(0.0f, 0.0f, 1.0f);
-        break;
-    default:
-        return;
+void Chunk::releaseMeshes() {
+    for (SectionMesh& sectionMesh : m_sectionMeshes) {
+        sectionMesh.mesh.reset();
+        sectionMesh.waterMesh.reset();
+        sectionMesh.occlusionMap.reset();
+        sectionMesh.faceCount = 0;
+        sectionMesh.quadCount = 0;
+        sectionMesh.revision = 0;
     }
-
-    uint32_t baseIndex = static_cast<uint32_t>(vertices.size());
-    vertices.push_back(v1);
-    vertices.push_back(v2);
-    vertices.push_back(v3);
-    vertices.push_back(v4);
-
-    normals.push_back(normal);
-    normals.push_back(normal);
-    normals.push_back(normal);
-    normals.push_back(normal);
-
-    indices.push_back(baseIndex);
-    indices.push_back(baseIndex + 1);
-    indices.push_back(baseIndex + 2);
-    indices.push_back(baseIndex + 2);
-    indices.push_back(baseIndex + 3);
-    indices.push_back(baseIndex);
 }
 
-BiomeType Chunk::getBiomeType(fnl_state& noise, int x, int z) const
-{
-    // Simple example of determining biome based on noise value.
-    float biomeNoise = fnlGetNoise2D(&noise, m_x + x, m_z + z);
-
-    if (biomeNoise < -0.3f) {
-        return BiomeType::Desert;
+int Chunk::getFaceCount() const {
+    int count = 0;
+    for (const SectionMesh& sectionMesh : m_sectionMeshes) {
+        count += sectionMesh.faceCount;
     }
-    else if (biomeNoise < 0.3f) {
-        return BiomeType::Plains;
+    return count;
+}
+
+int Chunk::getQuadCount() const {
+    int count = 0;
+    for (const SectionMesh& sectionMesh : m_sectionMeshes) {
+        count += sectionMesh.quadCount;
     }
-	else if (biomeNoise < 0.6f) {
-		return BiomeType::Forest;
-	}
-	else {
-		return BiomeType::Mountains;
-	}
+    return count;
 }
 
-void Chunk::placeTree(int x, int y, int z)
+void Chunk::placeTree(int x, int y, int z, std::mt19937& random)
 {
-    int trunkHeight = rand() % 4 + 3; ; 
+    int trunkHeight = random() % 4 + 3;
     int treeTopHeight = y + trunkHeight;
 
 	if (treeTopHeight >= CHUNK_HEIGHT)
@@ -364,7 +426,7 @@ void Chunk::placeTree(int x, int y, int z)
     // Place trunk blocks
     for (int h = y; h < treeTopHeight && h < CHUNK_HEIGHT; h++)
     {
-        cubes[x][h][z] = BlockType::Wood;
+        setBlockType(x, h, z, BlockType::Wood);
     }
 
     // Place leaves
@@ -379,12 +441,18 @@ void Chunk::placeTree(int x, int y, int z)
                 int leafY = leafStart + ly;
                 int leafZ = z + lz;
 
-                // Make sure leaves are within bounds of the chunk
-                if (leafX >= 0 && leafX < CHUNK_SIZE &&
-                    leafY >= 0 && leafY < CHUNK_HEIGHT &&
-                    leafZ >= 0 && leafZ < CHUNK_SIZE)
+                if (leafY < 0 || leafY >= CHUNK_HEIGHT) {
+                    continue;
+                }
+
+                // Leaves past the border belong to a neighbor, which may not exist yet
+                if (leafX >= 0 && leafX < CHUNK_SIZE && leafZ >= 0 && leafZ < CHUNK_SIZE)
                 {
-                    cubes[leafX][leafY][leafZ] = BlockType::Leaves;
+                    setBlockType(leafX, leafY, leafZ, BlockType::Leaves);
+                }
+                else
+                {
+                    m_outgoingWrites.push_back({ m_x + leafX, leafY, m_z + leafZ, BlockType::Leaves });
                 }
             }
         }
@@ -393,82 +461,5 @@ void Chunk::placeTree(int x, int y, int z)
 
 
 
-bool Chunk::isFaceVisible(int x, int y, int z, int direction, BlockType faceType)
-{
-    auto isBlockTransparent = [](BlockType type) {
-        return type == BlockType::None || type == BlockType::Water;
-        };
-
-    const Chunk* neighbor = nullptr;
-    int neighborX = x, neighborY = y, neighborZ = z;
-
-    switch (direction) {
-    case 0: // Left face
-        if (x == 0) {
-			neighbor = m_chunkManager->getChunk(m_x - CHUNK_SIZE, m_y, m_z);
-            neighborX = CHUNK_SIZE - 1;
-        }
-        else {
-            return faceType == BlockType::Water ? (cubes[x - 1][y][z] == BlockType::None) : isBlockTransparent(cubes[x - 1][y][z]);
-        }
-        break;
-    case 1: // Right face
-        if (x == CHUNK_SIZE - 1) {
-			neighbor = m_chunkManager->getChunk(m_x + CHUNK_SIZE, m_y, m_z);
-            neighborX = 0;
-        }
-        else {
-			return faceType == BlockType::Water ? (cubes[x + 1][y][z] == BlockType::None) : isBlockTransparent(cubes[x + 1][y][z]);
-        }
-        break;
-    case 2: // Bottom face
-        if (y == 0) {
-			neighbor = m_chunkManager->getChunk(m_x, m_y - CHUNK_HEIGHT, m_z);
-            neighborY = CHUNK_HEIGHT - 1;
-        }
-        else {
-			return faceType == BlockType::Water ? (cubes[x][y - 1][z] == BlockType::None) : isBlockTransparent(cubes[x][y - 1][z]);
-        }
-        break;
-    case 3: // Top face
-        if (y == CHUNK_HEIGHT - 1) {
-			neighbor = m_chunkManager->getChunk(m_x, m_y + CHUNK_HEIGHT, m_z);
-            neighborY = 0;
-        }
-        else {
-			return faceType == BlockType::Water ? (cubes[x][y + 1][z] == BlockType::None) : isBlockTransparent(cubes[x][y + 1][z]);
-        }
-        break;
-    case 4: // Back face
-        if (z == 0) {
-			neighbor = m_chunkManager->getChunk(m_x, m_y, m_z - CHUNK_SIZE);
-            neighborZ = CHUNK_SIZE - 1;
-        }
-        else {
-			return faceType == BlockType::Water ? (cubes[x][y][z - 1] == BlockType::None) : isBlockTransparent(cubes[x][y][z - 1]);
-        }
-        break;
-    case 5: // Front face
-        if (z == CHUNK_SIZE - 1) {
-			neighbor = m_chunkManager->getChunk(m_x, m_y, m_z + CHUNK_SIZE);
-            neighborZ = 0;
-        }
-        else {
-			return faceType == BlockType::Water ? (cubes[x][y][z + 1] == BlockType::None) : isBlockTransparent(cubes[x][y][z + 1]);
-        }
-        break;
-    }
-
-    if (neighbor) {
-        BlockType neighborBlockType = neighbor->cubes[neighborX][neighborY][neighborZ];
-        if (faceType == BlockType::Water) {
-            return neighborBlockType == BlockType::None;
-        }
-        else {
-            return isBlockTransparent(neighborBlockType);
-        }
-    }
-    return false;
- }
 
 }; // namespace voxl
\ No newline at end of file
@@ -0,0 +1,93 @@
+#include "chunk_grid.h"
+
+#include <algorithm>
+
+namespace voxl {
+
+ChunkEntry ChunkGrid::insert(const glm::ivec3& chunkPos, Chunk* chunk)
+{
+	Slot& slot = m_slots[slotIndex(chunkPos.x, chunkPos.z)];
+	ChunkEntry displaced;
+	if (slot.entry >= 0) {
+		displaced = m_entries[slot.entry];
+		m_entries[slot.entry] = { chunkPos, chunk };
+		m_renderList[slot.entry] = makeRenderEntry(*chunk);
+	}
+	else {
+		slot.entry = static_cast<int>(m_entries.size());
+		m_entries.push_back({ chunkPos, chunk });
+		m_renderList.push_back(makeRenderEntry(*chunk));
+	}
+
+	slot.chunkX = chunkPos.x;
+	slot.chunkZ = chunkPos.z;
+	slot.chunk = chunk;
+	return displaced;
+}
+
+bool ChunkGrid::erase(const glm::ivec3& chunkPos)
+{
+	if (!contains(chunkPos)) {
+		return false;
+	}
+
+	Slot& slot = m_slots[slotIndex(chunkPos.x, chunkPos.z)];
+	int entry = slot.entry;
+
+	// Move the last entry into the hole to keep the list dense
+	const ChunkEntry& last = m_entries.back();
+	m_slots[slotIndex(last.chunkPos.x, last.chunkPos.z)].entry = entry;
+	m_entries[entry] = last;
+	m_entries.pop_back();
+	m_renderList[entry] = m_renderList.back();
+	m_renderList.pop_back();
+
+	slot = Slot();
+	return true;
+}
+
+void ChunkGrid::clear()
+{
+	m_slots.fill(Slot());
+	m_entries.clear();
+	m_renderList.clear();
+}
+
+void ChunkGrid::updateRenderEntry(const glm::ivec3& chunkPos)
+{
+	if (contains(chunkPos)) {
+		int entry = m_slots[slotIndex(chunkPos.x, chunkPos.z)].entry;
+		m_renderList[entry] = makeRenderEntry(*m_entries[entry].chunk);
+	}
+}
+
+RenderEntry ChunkGrid::makeRenderEntry(Chunk& chunk)
+{
+	RenderEntry entry;
+	entry.origin = chunk.getPosition();
+
+	int lowest = Chunk::SECTION_COUNT;
+	int highest = -1;
+	for (int section = 0; section < Chunk::SECTION_COUNT; section++) {
+		unsigned int occlusionMap = chunk.getOcclusionMap(section) ? chunk.getOcclusionMap(section)->texture : 0;
+		if (Mesh* mesh = chunk.getMesh(section)) {
+			entry.opaque[section] = { mesh->VAO, mesh->indexCount, occlusionMap };
+		}
+		if (Mesh* mesh = chunk.getWaterMesh(section)) {
+			entry.water[section] = { mesh->VAO, mesh->indexCount, occlusionMap };
+		}
+		if (entry.opaque[section].indexCount > 0 || entry.water[section].indexCount > 0) {
+			lowest = std::min(lowest, section);
+			highest = std::max(highest, section);
+		}
+	}
+
+	entry.boundsMin = entry.boundsMax = entry.origin;
+	if (highest >= 0) {
+		entry.boundsMin.y += lowest * ChunkSection::SIZE;
+		entry.boundsMax += glm::vec3(Chunk::CHUNK_SIZE, (highest + 1) * ChunkSection::SIZE, Chunk::CHUNK_SIZE);
+	}
+	return entry;
+}
+
+} // namespace voxl
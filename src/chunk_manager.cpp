@@ -1,15 +1,54 @@
 #include "chunk_manager.h"
 #include "chunk.h"
+#include <algorithm>
+#include <chrono>
+#include <fstream>
 #include <iostream>
+#include <memory>
 
 namespace voxl {
 
-ChunkManager::ChunkManager()
+ChunkManager::ChunkManager(const std::string& worldPath, uint32_t seed)
+	: m_seed(loadOrSaveSeed(worldPath, seed)), m_terrain(m_seed), m_worldPath(worldPath)
 {
+	loadPendingWrites();
+}
+
+uint32_t ChunkManager::loadOrSaveSeed(const std::filesystem::path& worldPath, uint32_t seed)
+{
+	if (worldPath.empty()) {
+		return seed;
+	}
+	std::filesystem::create_directories(worldPath);
+
+	std::filesystem::path path = worldPath / "seed.txt";
+	std::ifstream in(path);
+	uint32_t savedSeed;
+	if (in >> savedSeed) {
+		return savedSeed;
+	}
+
+	std::ofstream out(path);
+	out << seed << std::endl;
+	if (!out) {
+		std::cerr << "Failed to write world seed to " << path << std::endl;
+	}
+	return seed;
 }
 
 ChunkManager::~ChunkManager()
 {
+	// Chunks still on the workers are finished and saved with the rest
+	m_workers.wait();
+	for (GeneratedChunk& generated : m_generatedChunks) {
+		applyPendingWrites(generated.chunkPos, *generated.chunk);
+		m_chunksCache[generated.chunkPos] = generated.chunk;
+		distributeDecorationWrites(generated.chunkPos, *generated.chunk);
+	}
+	m_generatedChunks.clear();
+
+	saveChunks();
+
 	for (auto& chunk : m_chunksCache)
 	{
 		delete chunk.second;
@@ -20,147 +59,944 @@ ChunkManager::~ChunkManager()
 
 void ChunkManager::loadChunks(glm::vec3 playerPosition)
 {
-	// Load chunks around the player
-	int playerChunkX = static_cast<int>(playerPosition.x) / Chunk::CHUNK_SIZE;
-	int playerChunkZ = static_cast<int>(playerPosition.z) / Chunk::CHUNK_SIZE;
+	if (m_streamer.update(getPlayerChunk(playerPosition), glm::vec3(0.0f), m_chunks)) {
+		unloadChunks();
+	}
+	while (m_streamer.hasPending()) {
+		loadOrGenerateChunk(m_streamer.popNext());
+	}
+	m_workers.wait();
+	collectGeneratedChunks();
+	advanceStages();
+	enforceMemoryBudget();
+}
 
+glm::ivec3 ChunkManager::getPlayerChunk(const glm::vec3& playerPosition) const
+{
+	return glm::ivec3(toChunkCoord(static_cast<int>(std::floor(playerPosition.x))), 0, toChunkCoord(static_cast<int>(std::floor(playerPosition.z))));
+}
 
-	for (int x = playerChunkX - ChunkManager::LOAD_RADIUS; x < playerChunkX + ChunkManager::LOAD_RADIUS; x++)
+void ChunkManager::loadOrGenerateChunk(const glm::ivec3& chunkPos)
+{
+	if (m_chunks.contains(chunkPos) || m_generating.count(chunkPos) > 0) {
+		return;
+	}
+
+	auto cached = m_chunksCache.find(chunkPos);
+	if (cached != m_chunksCache.end()) {
+		m_cacheStats.hits++;
+		ChunkEntry displaced = m_chunks.insert(chunkPos, cached->second);
+		if (displaced.chunk != nullptr) {
+			markUnloaded(displaced.chunkPos);
+		}
+
+		auto position = m_unloadedPositions.find(chunkPos);
+		if (position != m_unloadedPositions.end()) {
+			m_unloadedChunks.erase(position->second);
+			m_unloadedPositions.erase(position);
+		}
+
+		// Its meshes may have been evicted while it was out of view, the scheduler brings them back
+		markStageDirty(chunkPos);
+		return;
+	}
+
+	m_cacheStats.misses++;
+	Chunk* chunk = new Chunk(chunkPos.x * Chunk::CHUNK_SIZE, 0, chunkPos.z * Chunk::CHUNK_SIZE, this);
+	if (loadChunk(chunkPos, *chunk)) {
+		// Saved chunks hold final voxels, except for neighbors decorated since
+		chunk->setStage(ChunkStage::Decorated);
+		applyPendingWrites(chunkPos, *chunk);
+		m_storageStats.loadedCount++;
+		addChunk(chunkPos, chunk);
+		return;
+	}
+	delete chunk;
+	submitGenerateJob(chunkPos);
+}
+
+void ChunkManager::submitGenerateJob(const glm::ivec3& chunkPos)
+{
+	m_generating.insert(chunkPos);
+
+	// The voxel stages only read the chunk itself and the terrain cache, so they run back to back
+	// on a worker. Stages that need neighbors run on the main thread in advanceStages().
+	m_workers.submit([this, chunkPos]() {
+		using Clock = std::chrono::steady_clock;
+		GeneratedChunk generated = { chunkPos, new Chunk(chunkPos.x * Chunk::CHUNK_SIZE, 0, chunkPos.z * Chunk::CHUNK_SIZE, this), {} };
+		Clock::time_point start = Clock::now();
+		auto endStage = [&](ChunkStage stage) {
+			Clock::time_point end = Clock::now();
+			generated.stageMs[static_cast<int>(stage)] = std::chrono::duration<double, std::milli>(end - start).count();
+			start = end;
+		};
+
+		generated.chunk->generateTerrain(m_terrain);
+		endStage(ChunkStage::Terrain);
+		generated.chunk->generateFluids();
+		endStage(ChunkStage::Fluids);
+		generated.chunk->decorate(m_terrain);
+		endStage(ChunkStage::Decorated);
+
+		std::lock_guard<std::mutex> lock(m_generatedMutex);
+		m_generatedChunks.push_back(generated);
+	});
+}
+
+void ChunkManager::collectGeneratedChunks()
+{
+	std::vector<GeneratedChunk> generated;
+	{
+		std::lock_guard<std::mutex> lock(m_generatedMutex);
+		generated.swap(m_generatedChunks);
+	}
+
+	for (const GeneratedChunk& result : generated)
 	{
-		for (int z = playerChunkZ - ChunkManager::LOAD_RADIUS; z < playerChunkZ + ChunkManager::LOAD_RADIUS; z++)
+		finishGeneratedChunk(result);
+
+		// The player moved away while it was generating, keep it for when they come back
+		if (m_streamer.isOutOfRange(result.chunkPos)) {
+			m_chunksCache[result.chunkPos] = result.chunk;
+			updateCacheBytes(*result.chunk);
+			markUnloaded(result.chunkPos);
+		}
+		else {
+			addChunk(result.chunkPos, result.chunk);
+		}
+		distributeDecorationWrites(result.chunkPos, *result.chunk);
+	}
+}
+
+void ChunkManager::finishGeneratedChunk(const GeneratedChunk& result)
+{
+	m_generating.erase(result.chunkPos);
+	m_storageStats.generatedCount++;
+	for (int stage = static_cast<int>(ChunkStage::Terrain); stage <= static_cast<int>(ChunkStage::Decorated); stage++) {
+		m_stageStats.completedCount[stage]++;
+		m_stageStats.totalMs[stage] += result.stageMs[stage];
+	}
+
+	applyPendingWrites(result.chunkPos, *result.chunk);
+}
+
+void ChunkManager::pregenerate(const glm::ivec3& minChunk, const glm::ivec3& maxChunk)
+{
+	// Strips of chunks along z, a few at a time so every worker has a job. A strip is complete once
+	// the strips on both sides are generated, their leaves are in, and it is saved and dropped.
+	// Saving runs on this thread while the workers generate the next batch.
+	const int stripLength = maxChunk.z - minChunk.z + 1;
+	const int stripsPerBatch = std::max(1, static_cast<int>(4 * m_workers.getThreadCount()) / stripLength);
+
+	std::vector<glm::ivec3> complete; // Saved while the next batch generates
+	std::vector<glm::ivec3> waiting;  // Last strip of the previous batch, waiting for its next neighbor
+	auto release = [&](const std::vector<glm::ivec3>& positions) {
+		for (const glm::ivec3& chunkPos : positions) {
+			Chunk* chunk = m_chunksCache[chunkPos];
+			saveChunk(chunkPos, *chunk);
+			if (chunk->isModified()) {
+				// Nowhere to save it, keep it rather than lose it
+				continue;
+			}
+			m_cacheBytes -= chunk->getCountedBytes();
+			delete chunk;
+			m_chunksCache.erase(chunkPos);
+		}
+	};
+
+	for (int firstX = minChunk.x; firstX <= maxChunk.x; firstX += stripsPerBatch)
+	{
+		int lastX = std::min(firstX + stripsPerBatch - 1, maxChunk.x);
+		for (int x = firstX; x <= lastX; x++) {
+			for (int z = minChunk.z; z <= maxChunk.z; z++) {
+				glm::ivec3 chunkPos(x, 0, z);
+				RegionFile* region = getRegion(chunkPos);
+				if (m_chunksCache.count(chunkPos) > 0 || m_generating.count(chunkPos) > 0 ||
+					(region != nullptr && region->hasChunk(chunkPos))) {
+					continue;
+				}
+				submitGenerateJob(chunkPos);
+			}
+		}
+
+		release(complete);
+		complete = waiting;
+		waiting.clear();
+		m_workers.wait();
+
+		std::vector<GeneratedChunk> generated;
 		{
-			glm::ivec3 chunkPos(x, 0, z);
-			if (m_chunksCache.find(chunkPos) == m_chunksCache.end()) {
-				if (m_chunks.find(chunkPos) == m_chunks.end()) {
-					Chunk* chunk = new Chunk(x * Chunk::CHUNK_SIZE, 0, z * Chunk::CHUNK_SIZE, this);
-					chunk->generate();
-					m_chunks[chunkPos] = chunk;
-					m_chunksCache[chunkPos] = chunk;
-					m_updateList.insert(chunkPos);
-
-					// Update neighboring chunks
-					std::vector<glm::ivec3> neighbors = {
-						glm::ivec3(x - 1, 0, z),
-						glm::ivec3(x + 1, 0, z),
-						glm::ivec3(x, 0, z - 1),
-						glm::ivec3(x, 0, z + 1)
-					};
-
-					for (const auto& neighborPos : neighbors) {
-						if (m_chunks.find(neighborPos) != m_chunks.end()) {
-							m_updateList.insert(neighborPos);
-						}
+			std::lock_guard<std::mutex> lock(m_generatedMutex);
+			generated.swap(m_generatedChunks);
+		}
+		for (const GeneratedChunk& result : generated)
+		{
+			finishGeneratedChunk(result);
+			m_chunksCache[result.chunkPos] = result.chunk;
+			updateCacheBytes(*result.chunk);
+			distributeDecorationWrites(result.chunkPos, *result.chunk);
+			(result.chunkPos.x == lastX ? waiting : complete).push_back(result.chunkPos);
+		}
+	}
+
+	release(complete);
+	release(waiting);
+	savePendingWrites();
+}
+
+void ChunkManager::distributeDecorationWrites(const glm::ivec3& chunkPos, Chunk& chunk)
+{
+	std::vector<DecorationWrite> writes = chunk.takeOutgoingWrites();
+	if (!m_decoratedChunks.insert(chunkPos).second) {
+		return;
+	}
+
+	std::unordered_set<glm::ivec3> sections;
+	for (const DecorationWrite& write : writes)
+	{
+		glm::ivec3 targetPos(toChunkCoord(write.x), 0, toChunkCoord(write.z));
+		auto target = m_chunksCache.find(targetPos);
+		if (target == m_chunksCache.end()) {
+			m_pendingWrites[targetPos].push_back(write);
+		}
+		else if (target->second->applyDecorationWrite(write)) {
+			addBlockSections(glm::ivec3(write.x, write.y, write.z), sections);
+			updateCacheBytes(*target->second);
+		}
+	}
+	m_updateList.insert(sections.begin(), sections.end());
+}
+
+void ChunkManager::applyPendingWrites(const glm::ivec3& chunkPos, Chunk& chunk)
+{
+	auto pending = m_pendingWrites.find(chunkPos);
+	if (pending == m_pendingWrites.end()) {
+		return;
+	}
+	for (const DecorationWrite& write : pending->second) {
+		chunk.applyDecorationWrite(write);
+	}
+	m_pendingWrites.erase(pending);
+}
+
+void ChunkManager::loadPendingWrites()
+{
+	if (m_worldPath.empty()) {
+		return;
+	}
+
+	std::ifstream in(m_worldPath / "decorations.txt");
+	DecorationWrite write;
+	int type;
+	while (in >> write.x >> write.y >> write.z >> type) {
+		write.type = static_cast<BlockType>(type);
+		m_pendingWrites[glm::ivec3(toChunkCoord(write.x), 0, toChunkCoord(write.z))].push_back(write);
+	}
+
+	std::ifstream decorated(m_worldPath / "decorated.txt");
+	glm::ivec3 chunkPos(0);
+	while (decorated >> chunkPos.x >> chunkPos.z) {
+		m_decoratedChunks.insert(chunkPos);
+	}
+}
+
+void ChunkManager::savePendingWrites() const
+{
+	if (m_worldPath.empty()) {
+		return;
+	}
+
+	std::filesystem::path path = m_worldPath / "decorations.txt";
+	std::ofstream out(path);
+	for (const auto& pending : m_pendingWrites)
+	{
+		for (const DecorationWrite& write : pending.second) {
+			out << write.x << ' ' << write.y << ' ' << write.z << ' ' << static_cast<int>(write.type) << '\n';
+		}
+	}
+	if (!out) {
+		std::cerr << "Failed to write pending decorations to " << path << std::endl;
+	}
+
+	std::filesystem::path decoratedPath = m_worldPath / "decorated.txt";
+	std::ofstream decorated(decoratedPath);
+	for (const glm::ivec3& chunkPos : m_decoratedChunks) {
+		decorated << chunkPos.x << ' ' << chunkPos.z << '\n';
+	}
+	if (!decorated) {
+		std::cerr << "Failed to write decorated chunks to " << decoratedPath << std::endl;
+	}
+}
+
+void ChunkManager::addChunk(const glm::ivec3& chunkPos, Chunk* chunk)
+{
+	// A chunk a whole grid away can only be left over from a big jump, it is out of range anyway
+	ChunkEntry displaced = m_chunks.insert(chunkPos, chunk);
+	if (displaced.chunk != nullptr) {
+		markUnloaded(displaced.chunkPos);
+	}
+	m_chunksCache[chunkPos] = chunk;
+	updateCacheBytes(*chunk);
+
+	// It may complete the neighborhood of the chunks around it
+	markStageDirty(chunkPos);
+}
+
+ChunkStage ChunkManager::getTargetStage(const glm::ivec3& chunkPos) const
+{
+	int distance = m_streamer.getRingDistance(chunkPos);
+	if (distance <= MESH_RADIUS) {
+		return ChunkStage::Meshed;
+	}
+	if (distance < LOAD_RADIUS) {
+		return ChunkStage::Lit;
+	}
+	return ChunkStage::Decorated;
+}
+
+ChunkStage ChunkManager::getRequiredNeighborStage(ChunkStage stage)
+{
+	switch (stage) {
+	case ChunkStage::Lit:
+		return ChunkStage::Decorated;
+	case ChunkStage::Meshed:
+		return ChunkStage::Lit;
+	default:
+		return ChunkStage::Empty;
+	}
+}
+
+bool ChunkManager::hasNeighborsAt(const glm::ivec3& chunkPos, ChunkStage stage) const
+{
+	if (stage == ChunkStage::Empty) {
+		return true;
+	}
+	for (int dx = -1; dx <= 1; dx++) {
+		for (int dz = -1; dz <= 1; dz++) {
+			if (dx == 0 && dz == 0) {
+				continue;
+			}
+			const Chunk* neighbor = m_chunks.get(chunkPos.x + dx, chunkPos.z + dz);
+			if (neighbor == nullptr || neighbor->getStage() < stage) {
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+void ChunkManager::markStageDirty(const glm::ivec3& chunkPos)
+{
+	for (int dx = -1; dx <= 1; dx++) {
+		for (int dz = -1; dz <= 1; dz++) {
+			m_stageDirty.insert(glm::ivec3(chunkPos.x + dx, 0, chunkPos.z + dz));
+		}
+	}
+}
+
+void ChunkManager::advanceStages(double budgetMs)
+{
+	using Clock = std::chrono::steady_clock;
+	Clock::time_point start = Clock::now();
+
+	// Each chunk goes as far as its neighbors allow, then wakes the neighbors it may unblock
+	std::vector<glm::ivec3> pending(m_stageDirty.begin(), m_stageDirty.end());
+	m_stageDirty.clear();
+	while (!pending.empty())
+	{
+		if (budgetMs > 0.0 && std::chrono::duration<double, std::milli>(Clock::now() - start).count() > budgetMs) {
+			m_stageDirty.insert(pending.begin(), pending.end());
+			break;
+		}
+
+		glm::ivec3 chunkPos = pending.back();
+		pending.pop_back();
+		Chunk* chunk = m_chunks.get(chunkPos);
+		if (chunk == nullptr) {
+			continue;
+		}
+
+		ChunkStage target = getTargetStage(chunkPos);
+		bool advanced = false;
+		while (chunk->getStage() < target)
+		{
+			ChunkStage next = static_cast<ChunkStage>(static_cast<int>(chunk->getStage()) + 1);
+			if (!hasNeighborsAt(chunkPos, getRequiredNeighborStage(next))) {
+				break;
+			}
+			runStage(chunkPos, *chunk, next);
+			advanced = true;
+		}
+
+		if (advanced) {
+			for (int dx = -1; dx <= 1; dx++) {
+				for (int dz = -1; dz <= 1; dz++) {
+					if (dx != 0 || dz != 0) {
+						pending.push_back(glm::ivec3(chunkPos.x + dx, 0, chunkPos.z + dz));
 					}
 				}
 			}
-			else {
-				m_chunks[chunkPos] = m_chunksCache[chunkPos];
+		}
+	}
+}
+
+void ChunkManager::runStage(const glm::ivec3& chunkPos, Chunk& chunk, ChunkStage stage)
+{
+	// The voxel stages run on the workers before the chunk is added, only the stages that need
+	// neighbors get here. The stage is set first so the light engine sees the chunk as lit.
+	chunk.setStage(stage);
+	m_stageStats.completedCount[static_cast<int>(stage)]++;
+	if (stage == ChunkStage::Lit) {
+		using Clock = std::chrono::steady_clock;
+		Clock::time_point start = Clock::now();
+		m_light.lightChunk(chunkPos);
+		updateCacheBytesAround(chunkPos);
+		m_stageStats.totalMs[static_cast<int>(stage)] += std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+		// Light flowing across the border can reach meshed neighbors
+		std::unordered_set<glm::ivec3> sections;
+		addLightSections(sections);
+		m_updateList.insert(sections.begin(), sections.end());
+	}
+	else if (stage == ChunkStage::Meshed) {
+		queueSections(chunkPos);
+	}
+}
+
+bool ChunkManager::isMeshed(const glm::ivec3& chunkPos) const
+{
+	const Chunk* chunk = m_chunks.get(chunkPos);
+	return chunk != nullptr && chunk->getStage() == ChunkStage::Meshed;
+}
+
+ChunkStageStats ChunkManager::getStageStats() const
+{
+	ChunkStageStats stats = m_stageStats;
+	for (const ChunkEntry& entry : m_chunks.getEntries())
+	{
+		stats.chunkCount[static_cast<int>(entry.chunk->getStage())]++;
+	}
+	stats.generatingCount = m_generating.size();
+	for (const auto& pending : m_pendingWrites) {
+		stats.pendingWriteCount += pending.second.size();
+	}
+	return stats;
+}
+
+void ChunkManager::updateCacheBytes(Chunk& chunk)
+{
+	size_t bytes = chunk.getMemoryUsage() + chunk.getMeshMemoryUsage();
+	m_cacheBytes = m_cacheBytes - chunk.getCountedBytes() + bytes;
+	chunk.setCountedBytes(bytes);
+}
+
+void ChunkManager::updateCacheBytesAround(const glm::ivec3& chunkPos)
+{
+	for (int dx = -1; dx <= 1; dx++) {
+		for (int dz = -1; dz <= 1; dz++) {
+			auto it = m_chunksCache.find(glm::ivec3(chunkPos.x + dx, 0, chunkPos.z + dz));
+			if (it != m_chunksCache.end()) {
+				updateCacheBytes(*it->second);
 			}
 		}
 	}
 }
 
-void ChunkManager::updateChunks(glm::vec3 playerPosition)
+void ChunkManager::enforceMemoryBudget()
 {
-	loadChunks(playerPosition);
-	unloadChunks(playerPosition);
+	if (m_cacheBytes <= m_memoryBudget) {
+		return;
+	}
 
-	for (const glm::ivec3& chunkPos : m_updateList)
+	// Meshes first, they are rebuilt from the voxels when the chunk comes back into view
+	for (auto it = m_unloadedChunks.begin(); it != m_unloadedChunks.end() && m_cacheBytes > m_memoryBudget; ++it)
 	{
-		auto it = m_chunks.find(chunkPos);
-		if (it != m_chunks.end())
-		{
-			it->second->generateMesh();
+		Chunk* chunk = m_chunksCache[*it];
+		if (chunk->getMeshMemoryUsage() > 0) {
+			chunk->releaseMeshes();
+			chunk->setStage(ChunkStage::Lit);
+			updateCacheBytes(*chunk);
+			m_cacheStats.meshEvictions++;
 		}
 	}
 
+	// Then the voxels. Edited chunks are spilled to their region file first, the others are
+	// generated or loaded again, with the writes of their neighbors queued to be replayed.
+	for (auto it = m_unloadedChunks.begin(); it != m_unloadedChunks.end() && m_cacheBytes > m_memoryBudget;)
+	{
+		glm::ivec3 chunkPos = *it;
+		Chunk* chunk = m_chunksCache[chunkPos];
+		if (chunk->isEdited() && chunk->isModified()) {
+			saveChunk(chunkPos, *chunk);
+			if (chunk->isModified()) {
+				// Nowhere to spill it, evicting would lose the edits
+				++it;
+				continue;
+			}
+		}
+		else if (chunk->isModified()) {
+			std::vector<DecorationWrite> received = chunk->takeReceivedWrites();
+			std::vector<DecorationWrite>& pending = m_pendingWrites[chunkPos];
+			pending.insert(pending.end(), received.begin(), received.end());
+		}
+
+		m_cacheBytes -= chunk->getCountedBytes();
+		delete chunk;
+		m_chunksCache.erase(chunkPos);
+		m_unloadedPositions.erase(chunkPos);
+		it = m_unloadedChunks.erase(it);
+		m_cacheStats.chunkEvictions++;
+	}
+}
+
+ChunkCacheStats ChunkManager::getCacheStats() const
+{
+	ChunkCacheStats stats = m_cacheStats;
+	stats.cachedChunkCount = m_unloadedChunks.size();
+	stats.usedBytes = m_cacheBytes;
+	stats.budgetBytes = m_memoryBudget;
+	return stats;
+}
+
+RegionFile* ChunkManager::getRegion(const glm::ivec3& chunkPos)
+{
+	if (m_worldPath.empty()) {
+		return nullptr;
+	}
+
+	glm::ivec3 regionPos = RegionFile::getRegionPos(chunkPos);
+	auto it = m_regions.find(regionPos);
+	if (it == m_regions.end()) {
+		auto region = std::make_unique<RegionFile>(m_worldPath / RegionFile::getFileName(regionPos));
+		it = m_regions.emplace(regionPos, std::move(region)).first;
+	}
+	return it->second->isOpen() ? it->second.get() : nullptr;
+}
+
+bool ChunkManager::loadChunk(const glm::ivec3& chunkPos, Chunk& chunk)
+{
+	RegionFile* region = getRegion(chunkPos);
+	return region != nullptr && region->readChunk(chunkPos, chunk);
+}
+
+void ChunkManager::saveChunk(const glm::ivec3& chunkPos, Chunk& chunk)
+{
+	using Clock = std::chrono::steady_clock;
+	Clock::time_point start = Clock::now();
+	RegionFile* region = getRegion(chunkPos);
+	if (region != nullptr && region->writeChunk(chunkPos, chunk)) {
+		// The received writes are part of the saved voxels now
+		chunk.setModified(false);
+		chunk.takeReceivedWrites();
+		updateCacheBytes(chunk);
+		m_storageStats.savedCount++;
+		m_storageStats.savedBytes += region->getChunkSize(chunkPos);
+	}
+	m_storageStats.saveMs += std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+void ChunkManager::saveChunks()
+{
+	for (auto& chunk : m_chunksCache)
+	{
+		if (chunk.second->isModified()) {
+			saveChunk(chunk.first, *chunk.second);
+		}
+	}
+	savePendingWrites();
+}
+
+void ChunkManager::queueSections(const glm::ivec3& chunkPos)
+{
+	for (int section = 0; section < Chunk::SECTION_COUNT; section++) {
+		queueSection(chunkPos, section);
+	}
+}
+
+void ChunkManager::queueSection(const glm::ivec3& chunkPos, int section)
+{
+	if (section >= 0 && section < Chunk::SECTION_COUNT && isMeshed(chunkPos)) {
+		m_updateList.insert(glm::ivec3(chunkPos.x, section, chunkPos.z));
+	}
+}
+
+void ChunkManager::updateChunks(glm::vec3 playerPosition, glm::vec3 viewDirection)
+{
+	using Clock = std::chrono::steady_clock;
+	auto elapsedMs = [](Clock::time_point start) {
+		return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	};
+
+	// Load and unload sets only change when the player enters another chunk
+	if (m_streamer.update(getPlayerChunk(playerPosition), viewDirection, m_chunks)) {
+		unloadChunks();
+
+		// Target stages depend on the distance to the player
+		for (const ChunkEntry& entry : m_chunks.getEntries()) {
+			m_stageDirty.insert(entry.chunkPos);
+		}
+	}
+
+	// Enough generation jobs in flight to keep every worker busy without queueing chunks the
+	// player may have walked away from by the time they run
+	const size_t maxGenerating = 2 * m_workers.getThreadCount();
+	Clock::time_point start = Clock::now();
+	while (m_streamer.hasPending() && m_generating.size() < maxGenerating) {
+		loadOrGenerateChunk(m_streamer.popNext());
+		if (elapsedMs(start) > LOAD_BUDGET_MS) {
+			break;
+		}
+	}
+
+	collectGeneratedChunks();
+	advanceStages(STAGE_BUDGET_MS);
+	enforceMemoryBudget();
+
+	flushDirtyBlocks();
+	submitDirtySections();
+	uploadCompletedMeshes();
+}
+
+void ChunkManager::submitDirtySections()
+{
+	if (m_updateList.empty()) {
+		return;
+	}
+
+	// Nearest sections first, whatever doesn't fit in the budget waits for the next frame
+	std::vector<glm::ivec3> dirty(m_updateList.begin(), m_updateList.end());
+	std::vector<float> priorities(dirty.size());
+	std::vector<size_t> order(dirty.size());
+	for (size_t i = 0; i < dirty.size(); i++) {
+		priorities[i] = m_streamer.getPriority(glm::ivec3(dirty[i].x, 0, dirty[i].z));
+		order[i] = i;
+	}
+	std::sort(order.begin(), order.end(), [&](size_t a, size_t b) { return priorities[a] < priorities[b]; });
+
+	using Clock = std::chrono::steady_clock;
+	Clock::time_point start = Clock::now();
 	m_updateList.clear();
+	for (size_t i = 0; i < order.size(); i++)
+	{
+		const glm::ivec3& sectionKey = dirty[order[i]];
+		if (i > 0 && std::chrono::duration<double, std::milli>(Clock::now() - start).count() > MESH_SUBMIT_BUDGET_MS) {
+			m_updateList.insert(sectionKey);
+			continue;
+		}
+
+		// Snapshot on this thread and mesh in the background
+		glm::ivec3 chunkPos(sectionKey.x, 0, sectionKey.z);
+		Chunk* chunk = m_chunks.get(chunkPos);
+		if (chunk != nullptr)
+		{
+			submitMeshJob(chunkPos, chunk, sectionKey.y);
+		}
+	}
+}
+
+bool ChunkManager::isSectionHidden(const glm::ivec3& chunkPos, const Chunk& chunk, int section) const
+{
+	const ChunkSection& current = chunk.getSection(section);
+	if (current.isEmpty()) {
+		return true;
+	}
+	if (!current.isFullyOpaque()) {
+		return false;
+	}
+
+	// The column ends and missing chunks are padded solid by the snapshot, so they hide faces too
+	if (section > 0 && !chunk.getSection(section - 1).isFullyOpaque()) {
+		return false;
+	}
+	if (section < Chunk::SECTION_COUNT - 1 && !chunk.getSection(section + 1).isFullyOpaque()) {
+		return false;
+	}
+
+	const glm::ivec3 neighbors[4] = {
+		glm::ivec3(chunkPos.x - 1, 0, chunkPos.z),
+		glm::ivec3(chunkPos.x + 1, 0, chunkPos.z),
+		glm::ivec3(chunkPos.x, 0, chunkPos.z - 1),
+		glm::ivec3(chunkPos.x, 0, chunkPos.z + 1)
+	};
+	for (const glm::ivec3& neighborPos : neighbors) {
+		Chunk* neighbor = m_chunks.get(neighborPos);
+		if (neighbor != nullptr && !neighbor->getSection(section).isFullyOpaque()) {
+			return false;
+		}
+	}
+	return true;
+}
+
+void ChunkManager::submitMeshJob(const glm::ivec3& chunkPos, Chunk* chunk, int section)
+{
+	unsigned int revision = ++m_meshRevision;
+	chunk->setMeshRevision(section, revision);
+
+	// Nothing to draw, skip the snapshot and the worker round trip
+	if (isSectionHidden(chunkPos, *chunk, section)) {
+		ChunkMeshData data;
+		data.skipped = true;
+		chunk->uploadMesh(section, std::move(data));
+		updateCacheBytes(*chunk);
+		m_chunks.updateRenderEntry(chunkPos);
+		return;
+	}
+
+	using Clock = std::chrono::steady_clock;
+	Clock::time_point start = Clock::now();
+	auto snapshot = std::make_shared<const ChunkSnapshot>(*chunk, section, *this);
+	if (m_editSections.count(glm::ivec3(chunkPos.x, section, chunkPos.z)) > 0) {
+		m_editStats.lastEditMeshMs += std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	}
+	MeshingMode mode = m_meshingMode;
+
+	m_workers.submit([this, chunkPos, section, revision, snapshot, mode]() {
+		Clock::time_point buildStart = Clock::now();
+		ChunkMeshData data = ChunkMesher::buildMesh(*snapshot, mode);
+		double buildMs = std::chrono::duration<double, std::milli>(Clock::now() - buildStart).count();
+
+		std::lock_guard<std::mutex> lock(m_completedMutex);
+		m_completedMeshes.push_back({ chunkPos, section, revision, buildMs, std::move(data) });
+	});
 }
 
-void ChunkManager::unloadChunks(glm::vec3 playerPosition)
+void ChunkManager::uploadCompletedMeshes()
+{
+	std::vector<CompletedMesh> completed;
+	{
+		std::lock_guard<std::mutex> lock(m_completedMutex);
+		completed.swap(m_completedMeshes);
+	}
+
+	using Clock = std::chrono::steady_clock;
+	Clock::time_point start = Clock::now();
+	size_t uploaded = 0;
+	for (; uploaded < completed.size(); uploaded++)
+	{
+		if (uploaded > 0 && std::chrono::duration<double, std::milli>(Clock::now() - start).count() > UPLOAD_BUDGET_MS) {
+			break;
+		}
+
+		CompletedMesh& mesh = completed[uploaded];
+		auto it = m_chunksCache.find(mesh.chunkPos);
+		// Drop results superseded by a newer request for the same section
+		if (it != m_chunksCache.end() && it->second->getMeshRevision(mesh.section) == mesh.revision)
+		{
+			Clock::time_point uploadStart = Clock::now();
+			it->second->uploadMesh(mesh.section, std::move(mesh.data));
+			updateCacheBytes(*it->second);
+			m_chunks.updateRenderEntry(mesh.chunkPos);
+			m_stageStats.totalMs[static_cast<int>(ChunkStage::Meshed)] += mesh.buildMs;
+
+			if (m_editSections.erase(glm::ivec3(mesh.chunkPos.x, mesh.section, mesh.chunkPos.z)) > 0) {
+				m_editStats.lastEditMeshMs += mesh.buildMs + std::chrono::duration<double, std::milli>(Clock::now() - uploadStart).count();
+			}
+		}
+	}
+
+	// Over budget, keep the rest ahead of newer results
+	if (uploaded < completed.size()) {
+		std::lock_guard<std::mutex> lock(m_completedMutex);
+		m_completedMeshes.insert(m_completedMeshes.begin(),
+			std::make_move_iterator(completed.begin() + uploaded), std::make_move_iterator(completed.end()));
+	}
+}
+
+void ChunkManager::unloadChunks()
 {
 	// Unload chunks that are too far away from the player
-	int playerChunkX = static_cast<int>(playerPosition.x) / Chunk::CHUNK_SIZE;
-	int playerChunkZ = static_cast<int>(playerPosition.z) / Chunk::CHUNK_SIZE;
 	std::vector<glm::ivec3> chunksToRemove;
-	for (auto& chunk : m_chunks)
+	for (const ChunkEntry& entry : m_chunks.getEntries())
 	{
-		int chunkX = chunk.second->getPosition().x / Chunk::CHUNK_SIZE;
-		int chunkZ = chunk.second->getPosition().z / Chunk::CHUNK_SIZE;
-		if (abs(chunkX - playerChunkX) > ChunkManager::LOAD_RADIUS || abs(chunkZ - playerChunkZ) > ChunkManager::LOAD_RADIUS)
+		if (m_streamer.isOutOfRange(entry.chunkPos))
 		{
-			chunksToRemove.push_back(glm::ivec3(chunkX, 0, chunkZ));
+			chunksToRemove.push_back(entry.chunkPos);
 		}
 	}
 	for (auto& chunk : chunksToRemove)
 	{
 		m_chunks.erase(chunk);
+		markUnloaded(chunk);
 	}
 }
 
+void ChunkManager::markUnloaded(const glm::ivec3& chunkPos)
+{
+	// Still cached, most recently used
+	m_unloadedPositions[chunkPos] = m_unloadedChunks.insert(m_unloadedChunks.end(), chunkPos);
+}
+
 Chunk* ChunkManager::getChunk(float x, float y, float z) const {
-	// Calculate chunk coordinates properly for both positive and negative values
-	int chunkX = static_cast<int>(std::floor(x / Chunk::CHUNK_SIZE));
-	int chunkY = static_cast<int>(std::floor(y / Chunk::CHUNK_HEIGHT));
-	int chunkZ = static_cast<int>(std::floor(z / Chunk::CHUNK_SIZE));
+	int blockY = static_cast<int>(std::floor(y));
+	if (blockY < 0 || blockY >= Chunk::CHUNK_HEIGHT) {
+		return nullptr;
+	}
+	return m_chunks.get(toChunkCoord(static_cast<int>(std::floor(x))), toChunkCoord(static_cast<int>(std::floor(z))));
+}
+
+void ChunkManager::markBlockDirty(Chunk* chunk, const glm::ivec3& localPos)
+{
+	glm::ivec3 origin = chunk->getPosition();
+	m_dirtyBlocks.push_back(origin + localPos);
+	chunk->setEdited();
+}
+
+void ChunkManager::addBlockSections(const glm::ivec3& block, std::unordered_set<glm::ivec3>& sections) const
+{
+	auto addSection = [&](const glm::ivec3& chunkPos, int section) {
+		if (section >= 0 && section < Chunk::SECTION_COUNT && isMeshed(chunkPos)) {
+			sections.insert(glm::ivec3(chunkPos.x, section, chunkPos.z));
+		}
+	};
 
+	glm::ivec3 chunkPos(toChunkCoord(block.x), 0, toChunkCoord(block.z));
+	glm::ivec3 local = block - chunkPos * Chunk::CHUNK_SIZE;
+	int section = local.y / ChunkSection::SIZE;
+	int sectionY = local.y % ChunkSection::SIZE;
 
-	glm::ivec3 chunkPos(chunkX, chunkY, chunkZ);
-	auto it = m_chunks.find(chunkPos);
-	if (it != m_chunks.end()) {
-		return it->second;
+	// A block on a section border is also part of the snapshots across it, diagonal ones
+	// included since ambient occlusion reads the corners of the padding
+	auto borderRange = [](int coord, int size, int& low, int& high) {
+		low = coord == 0 ? -1 : 0;
+		high = coord == size - 1 ? 1 : 0;
+	};
+	int minX, maxX, minZ, maxZ, minSection, maxSection;
+	borderRange(local.x, Chunk::CHUNK_SIZE, minX, maxX);
+	borderRange(local.z, Chunk::CHUNK_SIZE, minZ, maxZ);
+	borderRange(sectionY, ChunkSection::SIZE, minSection, maxSection);
+	for (int dx = minX; dx <= maxX; dx++) {
+		for (int dz = minZ; dz <= maxZ; dz++) {
+			for (int ds = minSection; ds <= maxSection; ds++) {
+				addSection(chunkPos + glm::ivec3(dx, 0, dz), section + ds);
+			}
+		}
 	}
-	return nullptr;
 }
 
+void ChunkManager::addLightSections(std::unordered_set<glm::ivec3>& sections)
+{
+	for (const glm::ivec3& block : m_light.takeChangedBlocks())
+	{
+		addBlockSections(block, sections);
+	}
+}
 
-void ChunkManager::updateChunk(Chunk* chunk)
+void ChunkManager::flushDirtyBlocks()
 {
-	glm::vec3 chunkPos = chunk->getPosition();
-	chunkPos.x = static_cast<int>(chunkPos.x) / Chunk::CHUNK_SIZE;
-	chunkPos.z = static_cast<int>(chunkPos.z) / Chunk::CHUNK_SIZE;
-	m_updateList.insert(chunkPos);
+	if (m_dirtyBlocks.empty()) {
+		return;
+	}
 
-	// Update neighboring chunks
-	std::vector<glm::ivec3> neighbors = {
-		glm::ivec3(chunkPos.x - 1, 0, chunkPos.z),
-		glm::ivec3(chunkPos.x + 1, 0, chunkPos.z),
-		glm::ivec3(chunkPos.x, 0, chunkPos.z - 1),
-		glm::ivec3(chunkPos.x, 0, chunkPos.z + 1)
-	};
+	using Clock = std::chrono::steady_clock;
+	Clock::time_point start = Clock::now();
+	for (const glm::ivec3& block : m_dirtyBlocks)
+	{
+		m_light.updateBlock(block);
+	}
+	m_editStats.lastEditLightMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
 
-	for (const auto& neighborPos : neighbors) {
-		if (m_chunks.find(neighborPos) != m_chunks.end()) {
-			m_updateList.insert(neighborPos);
-		}
+	std::unordered_set<glm::ivec3> editedChunks;
+	for (const glm::ivec3& block : m_dirtyBlocks)
+	{
+		editedChunks.insert(glm::ivec3(toChunkCoord(block.x), 0, toChunkCoord(block.z)));
+	}
+	for (const glm::ivec3& chunkPos : editedChunks)
+	{
+		updateCacheBytesAround(chunkPos);
 	}
+
+	std::unordered_set<glm::ivec3> sections;
+	for (const glm::ivec3& block : m_dirtyBlocks)
+	{
+		addBlockSections(block, sections);
+	}
+	addLightSections(sections);
+
+	m_editStats.editCount += m_dirtyBlocks.size();
+	m_editStats.remeshedSectionCount += sections.size();
+	m_editStats.lastEditSectionCount = sections.size();
+	m_editStats.lastEditMeshMs = 0.0;
+	m_editSections = sections;
+	m_updateList.insert(sections.begin(), sections.end());
+	m_dirtyBlocks.clear();
 }
+
 BlockType ChunkManager::getBlockType(float x, float y, float z) const
 {
-	Chunk* chunk = getChunk(x, y, z);
-	if (chunk == nullptr) {
+	int blockX = static_cast<int>(std::floor(x));
+	int blockY = static_cast<int>(std::floor(y));
+	int blockZ = static_cast<int>(std::floor(z));
+	if (blockY < 0 || blockY >= Chunk::CHUNK_HEIGHT) {
 		return BlockType::None;
 	}
 
-	glm::vec3 localPos = glm::vec3(x, y, z) - chunk->getPosition();
-
-	glm::ivec3 localBlockPos = glm::floor(localPos);
+	int chunkX = toChunkCoord(blockX);
+	int chunkZ = toChunkCoord(blockZ);
+	Chunk* chunk = m_chunks.get(chunkX, chunkZ);
+	if (chunk == nullptr) {
+		return BlockType::None;
+	}
 
-	return chunk->cubes[localBlockPos.x][localBlockPos.y][localBlockPos.z];
+	return chunk->getBlockType(blockX - chunkX * Chunk::CHUNK_SIZE, blockY, blockZ - chunkZ * Chunk::CHUNK_SIZE);
 }
 
 bool ChunkManager::isSolidBlock(float x, float y, float z) const
 {
-	Chunk* chunk = getChunk(x, y, z);
-	if (chunk == nullptr) {
-		return false;
+	BlockType type = getBlockType(x, y, z);
+	return type != BlockType::None && type != BlockType::Water;
+}
+
+ChunkMemoryStats ChunkManager::getMemoryStats() const
+{
+	ChunkMemoryStats stats;
+	for (const auto& chunk : m_chunksCache)
+	{
+		stats.chunkCount++;
+		stats.lightBytes += chunk.second->getLightMemoryUsage();
+		stats.voxelBytes += chunk.second->getMemoryUsage() - chunk.second->getLightMemoryUsage();
+		for (int i = 0; i < Chunk::SECTION_COUNT; i++)
+		{
+			stats.sectionCount++;
+			if (chunk.second->getSection(i).isUniform()) {
+				stats.uniformSectionCount++;
+			}
+		}
 	}
+	stats.denseBytes = stats.chunkCount * Chunk::CHUNK_SIZE * Chunk::CHUNK_HEIGHT * Chunk::CHUNK_SIZE * sizeof(BlockType);
+	return stats;
+}
 
-	glm::vec3 localPos = glm::vec3(x, y, z) - chunk->getPosition();
+ChunkMeshStats ChunkManager::getMeshStats() const
+{
+	ChunkMeshStats stats;
+	for (const ChunkEntry& entry : m_chunks.getEntries())
+	{
+		stats.faceCount += entry.chunk->getFaceCount();
+		stats.quadCount += entry.chunk->getQuadCount();
+		for (int i = 0; i < Chunk::SECTION_COUNT; i++)
+		{
+			if (entry.chunk->isSectionSkipped(i)) {
+				stats.skippedSectionCount++;
+			}
+			else {
+				stats.meshedSectionCount++;
+			}
+		}
+	}
+	return stats;
+}
 
-	glm::ivec3 localBlockPos = glm::floor(localPos);
+void ChunkManager::setMeshingMode(MeshingMode mode)
+{
+	if (mode == m_meshingMode) {
+		return;
+	}
+	m_meshingMode = mode;
 
-	return chunk->cubes[localBlockPos.x][localBlockPos.y][localBlockPos.z] != BlockType::None &&
-		chunk->cubes[localBlockPos.x][localBlockPos.y][localBlockPos.z] != BlockType::Water;
+	// Rebuild every loaded mesh with the new mode
+	for (const ChunkEntry& entry : m_chunks.getEntries())
+	{
+		queueSections(entry.chunkPos);
+	}
 }
-} // namespace voxl
\ No newline at end of file
+} // namespace voxl
@@ -0,0 +1,398 @@
+#include "chunk_mesher.h"
+#include "chunk_manager.h"
+#include "world_view.h"
+
+#include <algorithm>
+#include <bit>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define VOXL_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace voxl {
+
+ChunkSnapshot::ChunkSnapshot(const Chunk& chunk, int section, const ChunkManager& chunkManager)
+	: m_blocks(SIZE * SIZE * SIZE, MISSING_NEIGHBOR), m_light(SIZE * SIZE * SIZE, 0), m_section(section)
+{
+	glm::ivec3 position = glm::ivec3(chunk.getPosition());
+	glm::ivec3 chunkPos(position.x / Chunk::CHUNK_SIZE, 0, position.z / Chunk::CHUNK_SIZE);
+
+	// The blocks with their border in one box read, missing neighbors and the world's top and
+	// bottom come out as the placeholder
+	glm::ivec3 min(position.x - 1, section * ChunkSection::SIZE - 1, position.z - 1);
+	WorldView view(chunkManager);
+	view.getChunkAt(position.x, position.z); // Centers the view, the box then stays inside its 3x3 chunks
+	view.readRegion(min, min + glm::ivec3(SIZE - 1), m_blocks.data(), MISSING_NEIGHBOR);
+
+	for (int offsetX = -1; offsetX <= 1; offsetX++) {
+		for (int offsetZ = -1; offsetZ <= 1; offsetZ++) {
+			if (offsetX == 0 && offsetZ == 0) {
+				copyLight(&chunk, 0, 0);
+			}
+			else {
+				copyLight(chunkManager.getChunk(chunkPos + glm::ivec3(offsetX, 0, offsetZ)), offsetX, offsetZ);
+			}
+		}
+	}
+}
+
+void ChunkSnapshot::copyLight(const Chunk* chunk, int offsetX, int offsetZ)
+{
+	if (chunk == nullptr) {
+		return;
+	}
+
+	// Only the last/first slice of a neighbor overlaps the border
+	int minX = offsetX < 0 ? Chunk::CHUNK_SIZE - 1 : 0;
+	int maxX = offsetX > 0 ? 0 : Chunk::CHUNK_SIZE - 1;
+	int minZ = offsetZ < 0 ? Chunk::CHUNK_SIZE - 1 : 0;
+	int maxZ = offsetZ > 0 ? 0 : Chunk::CHUNK_SIZE - 1;
+
+	const LightSection& sourceLight = chunk->getLightSection(m_section);
+	int baseY = m_section * ChunkSection::SIZE;
+
+	for (int x = minX; x <= maxX; x++) {
+		for (int z = minZ; z <= maxZ; z++) {
+			uint8_t* lightColumn = &m_light[index(x + offsetX * Chunk::CHUNK_SIZE, 0, z + offsetZ * Chunk::CHUNK_SIZE)];
+			if (sourceLight.isUniform()) {
+				std::fill_n(lightColumn, ChunkSection::SIZE, sourceLight.get(x, 0, z));
+			}
+			else {
+				for (int y = 0; y < ChunkSection::SIZE; y++) {
+					lightColumn[y] = sourceLight.get(x, y, z);
+				}
+			}
+
+			// Border layers from the sections below and above
+			if (m_section > 0) {
+				lightColumn[-1] = chunk->getLight(x, baseY - 1, z);
+			}
+			if (m_section < Chunk::SECTION_COUNT - 1) {
+				lightColumn[ChunkSection::SIZE] = chunk->getLight(x, baseY + ChunkSection::SIZE, z);
+			}
+		}
+	}
+}
+
+bool ChunkSnapshot::isFaceVisible(int x, int y, int z, int direction, BlockType faceType) const
+{
+	static const int offsets[6][3] = {
+		{ -1, 0, 0 }, // Left face
+		{ 1, 0, 0 },  // Right face
+		{ 0, -1, 0 }, // Bottom face
+		{ 0, 1, 0 },  // Top face
+		{ 0, 0, -1 }, // Back face
+		{ 0, 0, 1 }   // Front face
+	};
+
+	BlockType neighbor = get(x + offsets[direction][0], y + offsets[direction][1], z + offsets[direction][2]);
+	if (faceType == BlockType::Water) {
+		return neighbor == BlockType::None;
+	}
+	return !isOpaque(neighbor);
+}
+
+namespace {
+
+// Normal of each face direction, faces take the light of the voxel they look into
+const glm::ivec3 FACE_NORMALS[6] = {
+	glm::ivec3(-1, 0, 0), glm::ivec3(1, 0, 0),
+	glm::ivec3(0, -1, 0), glm::ivec3(0, 1, 0),
+	glm::ivec3(0, 0, -1), glm::ivec3(0, 0, 1)
+};
+
+// Bit y + 1 of each mask is set for the blocks of a snapshot column, y going from -1 to SIZE - 2
+struct ColumnMasks {
+	uint64_t opaque;
+	uint64_t solid; // Anything but air
+};
+
+ColumnMasks buildColumnMasks(const BlockType* column)
+{
+	static_assert(ChunkSnapshot::SIZE <= 64, "a snapshot column must fit in a 64 bit mask");
+
+	ColumnMasks masks = { 0, 0 };
+	int y = 0;
+#ifdef VOXL_SSE2
+	// Air and water are the only non opaque blocks, see isOpaque
+	const __m128i air = _mm_setzero_si128();
+	const __m128i water = _mm_set1_epi8(static_cast<char>(BlockType::Water));
+	for (; y + 16 <= ChunkSnapshot::SIZE; y += 16) {
+		__m128i blocks = _mm_loadu_si128(reinterpret_cast<const __m128i*>(column + y));
+		__m128i isAir = _mm_cmpeq_epi8(blocks, air);
+		__m128i isClear = _mm_or_si128(isAir, _mm_cmpeq_epi8(blocks, water));
+		masks.solid |= static_cast<uint64_t>(~_mm_movemask_epi8(isAir) & 0xFFFF) << y;
+		masks.opaque |= static_cast<uint64_t>(~_mm_movemask_epi8(isClear) & 0xFFFF) << y;
+	}
+#endif
+	for (; y < ChunkSnapshot::SIZE; y++) {
+		masks.solid |= static_cast<uint64_t>(column[y] != BlockType::None) << y;
+		masks.opaque |= static_cast<uint64_t>(isOpaque(column[y])) << y;
+	}
+	return masks;
+}
+
+// Opaque faces show against anything see-through, water faces only against air
+uint64_t visibleFaces(const ColumnMasks& self, uint64_t neighborOpaque, uint64_t neighborSolid)
+{
+	uint64_t water = self.solid & ~self.opaque;
+	return (self.opaque & ~neighborOpaque) | (water & ~neighborSolid);
+}
+
+} // namespace
+
+FaceMasks::FaceMasks(const ChunkSnapshot& snapshot)
+{
+	const int size = ChunkSnapshot::SIZE;
+	ColumnMasks columns[ChunkSnapshot::SIZE][ChunkSnapshot::SIZE];
+	for (int x = -1; x < size - 1; x++) {
+		for (int z = -1; z < size - 1; z++) {
+			columns[x + 1][z + 1] = buildColumnMasks(snapshot.getColumn(x, z));
+			m_opaque[x + 1][z + 1] = columns[x + 1][z + 1].opaque;
+		}
+	}
+
+	for (int x = 0; x < ChunkSection::SIZE; x++) {
+		for (int z = 0; z < ChunkSection::SIZE; z++) {
+			const ColumnMasks& self = columns[x + 1][z + 1];
+			const ColumnMasks& left = columns[x][z + 1];
+			const ColumnMasks& right = columns[x + 2][z + 1];
+			const ColumnMasks& back = columns[x + 1][z];
+			const ColumnMasks& front = columns[x + 1][z + 2];
+
+			// Drop the padding bit so bit y is block y again
+			m_faces[0][x][z] = static_cast<uint32_t>(visibleFaces(self, left.opaque, left.solid) >> 1);
+			m_faces[1][x][z] = static_cast<uint32_t>(visibleFaces(self, right.opaque, right.solid) >> 1);
+			m_faces[2][x][z] = static_cast<uint32_t>(visibleFaces(self, self.opaque << 1, self.solid << 1) >> 1);
+			m_faces[3][x][z] = static_cast<uint32_t>(visibleFaces(self, self.opaque >> 1, self.solid >> 1) >> 1);
+			m_faces[4][x][z] = static_cast<uint32_t>(visibleFaces(self, back.opaque, back.solid) >> 1);
+			m_faces[5][x][z] = static_cast<uint32_t>(visibleFaces(self, front.opaque, front.solid) >> 1);
+		}
+	}
+}
+
+int FaceMasks::getFaceCount() const
+{
+	int count = 0;
+	for (int direction = 0; direction < 6; direction++) {
+		for (int x = 0; x < ChunkSection::SIZE; x++) {
+			for (int z = 0; z < ChunkSection::SIZE; z++) {
+				count += std::popcount(m_faces[direction][x][z]);
+			}
+		}
+	}
+	return count;
+}
+
+ChunkMeshData ChunkMesher::buildMesh(const ChunkSnapshot& snapshot, MeshingMode mode) {
+    ChunkMeshData data;
+    const int sectionSize = ChunkSection::SIZE;
+
+    // Section local y to chunk local y
+    const int baseY = snapshot.getSection() * ChunkSection::SIZE;
+
+    auto emitFace = [&](BlockType type, uint8_t light, int x, int y, int z, int direction, glm::ivec3 size) {
+        y += baseY;
+        if (type == BlockType::Water)
+        {
+            addFace(data.waterVertices, data.waterIndices, x, y, z, direction, size, type, light);
+        }
+        else
+        {
+            addFace(data.vertices, data.indices, x, y, z, direction, size, type, light);
+        }
+        data.quadCount++;
+    };
+
+    auto faceLight = [&](int x, int y, int z, int direction) {
+        const glm::ivec3& normal = FACE_NORMALS[direction];
+        return snapshot.getLight(x + normal.x, y + normal.y, z + normal.z);
+    };
+
+    FaceMasks faces(snapshot);
+    data.faceCount = faces.getFaceCount();
+
+    // Opacity around the faces for the fragment shader, ambient occlusion is shaded per pixel so
+    // it never keeps faces from merging
+    const int mapSize = ChunkSnapshot::SIZE;
+    data.occlusionColumns.resize(2 * mapSize * mapSize);
+    for (int x = -1; x < mapSize - 1; x++) {
+        for (int z = -1; z < mapSize - 1; z++) {
+            uint64_t column = faces.getOpaqueColumn(x, z);
+            uint32_t* texel = &data.occlusionColumns[2 * ((z + 1) * mapSize + (x + 1))];
+            texel[0] = static_cast<uint32_t>(column);
+            texel[1] = static_cast<uint32_t>(column >> 32);
+        }
+    }
+
+    if (mode == MeshingMode::Greedy) {
+        // Visible faces of each slice as rows of bits, rows[slice][j] bit i
+        uint32_t rows[ChunkSection::SIZE][ChunkSection::SIZE];
+        uint32_t faceKeys[ChunkSection::SIZE][ChunkSection::SIZE];
+
+        for (int direction = 0; direction < 6; direction++) {
+            // Axis along the face normal and the two axes spanning the face plane
+            int n = direction / 2;
+            int u = (n + 1) % 3;
+            int v = (n + 2) % 3;
+
+            // Transpose the y columns into the slice layout of this axis
+            std::fill_n(&rows[0][0], sectionSize * sectionSize, 0u);
+            for (int x = 0; x < sectionSize; x++) {
+                for (int z = 0; z < sectionSize; z++) {
+                    uint32_t bits = faces.get(direction, x, z);
+                    if (n == 0) {
+                        rows[x][z] = bits; // u = y, v = z
+                        continue;
+                    }
+                    while (bits != 0) {
+                        int y = std::countr_zero(bits);
+                        bits &= bits - 1;
+                        if (n == 1) {
+                            rows[y][x] |= 1u << z; // u = z, v = x
+                        }
+                        else {
+                            rows[z][y] |= 1u << x; // u = x, v = y
+                        }
+                    }
+                }
+            }
+
+            for (int slice = 0; slice < sectionSize; slice++) {
+                glm::ivec3 pos;
+                pos[n] = slice;
+                uint32_t* sliceRows = rows[slice];
+
+                // Type and light of each visible face, faces merge only when both match
+                for (int j = 0; j < sectionSize; j++) {
+                    for (uint32_t bits = sliceRows[j]; bits != 0; bits &= bits - 1) {
+                        int i = std::countr_zero(bits);
+                        pos[u] = i;
+                        pos[v] = j;
+                        faceKeys[j][i] = static_cast<uint32_t>(snapshot.get(pos.x, pos.y, pos.z)) | (faceLight(pos.x, pos.y, pos.z, direction) << 8);
+                    }
+                }
+                auto faceAt = [&](int i, int j) { return faceKeys[j][i]; };
+
+                // Merge matching faces into maximal rectangles
+                for (int j = 0; j < sectionSize; j++) {
+                    while (sliceRows[j] != 0) {
+                        int i = std::countr_zero(sliceRows[j]);
+                        uint32_t face = faceAt(i, j);
+
+                        int width = 1;
+                        while (i + width < sectionSize && (sliceRows[j] >> (i + width) & 1u) && faceAt(i + width, j) == face) {
+                            width++;
+                        }
+
+                        uint32_t span = (width == 32 ? ~0u : (1u << width) - 1) << i;
+                        int height = 1;
+                        while (j + height < sectionSize && (sliceRows[j + height] & span) == span) {
+                            bool sameFace = true;
+                            for (int k = 0; k < width && sameFace; k++) {
+                                sameFace = faceAt(i + k, j + height) == face;
+                            }
+                            if (!sameFace) {
+                                break;
+                            }
+                            height++;
+                        }
+
+                        for (int h = 0; h < height; h++) {
+                            sliceRows[j + h] &= ~span;
+                        }
+
+                        pos[u] = i;
+                        pos[v] = j;
+                        glm::ivec3 faceSize(1);
+                        faceSize[u] = width;
+                        faceSize[v] = height;
+                        emitFace(static_cast<BlockType>(face & 0xFF), static_cast<uint8_t>(face >> 8), pos.x, pos.y, pos.z, direction, faceSize);
+                    }
+                }
+            }
+        }
+    }
+    else {
+        for (int x = 0; x < sectionSize; x++) {
+            for (int z = 0; z < sectionSize; z++) {
+                for (int direction = 0; direction < 6; direction++) {
+                    uint32_t bits = faces.get(direction, x, z);
+                    while (bits != 0) {
+                        int y = std::countr_zero(bits);
+                        bits &= bits - 1;
+                        emitFace(snapshot.get(x, y, z), faceLight(x, y, z, direction), x, y, z, direction, glm::ivec3(1));
+                    }
+                }
+            }
+        }
+    }
+
+    return data;
+}
+
+void ChunkMesher::addFace(std::vector<ChunkVertex>& vertices, std::vector<uint32_t>& indices,
+    int x, int y, int z, int faceIndex, glm::ivec3 size, BlockType type, uint8_t light) {
+    glm::ivec3 v1, v2, v3, v4;
+
+    // size spans the face plane, the axis along the normal is always one block thick
+    int dx = size.x, dy = size.y, dz = size.z;
+
+    switch (faceIndex) {
+    case 0: // Left face
+        v1 = glm::ivec3(x, y, z + dz);
+        v2 = glm::ivec3(x, y + dy, z + dz);
+        v3 = glm::ivec3(x, y + dy, z);
+        v4 = glm::ivec3(x, y, z);
+        break;
+    case 1: // Right face
+        v1 = glm::ivec3(x + 1, y, z);
+        v2 = glm::ivec3(x + 1, y + dy, z);
+        v3 = glm::ivec3(x + 1, y + dy, z + dz);
+        v4 = glm::ivec3(x + 1, y, z + dz);
+        break;
+    case 2: // Bottom face
+        v1 = glm::ivec3(x + dx, y, z);
+        v2 = glm::ivec3(x + dx, y, z + dz);
+        v3 = glm::ivec3(x, y, z + dz);
+        v4 = glm::ivec3(x, y, z);
+        break;
+    case 3: // Top face
+        v1 = glm::ivec3(x, y + 1, z + dz);
+        v2 = glm::ivec3(x + dx, y + 1, z + dz);
+        v3 = glm::ivec3(x + dx, y + 1, z);
+        v4 = glm::ivec3(x, y + 1, z);
+        break;
+    case 4: // Back face
+        v1 = glm::ivec3(x + dx, y, z);
+        v2 = glm::ivec3(x, y, z);
+        v3 = glm::ivec3(x, y + dy, z);
+        v4 = glm::ivec3(x + dx, y + dy, z);
+        break;
+    case 5: // Front face
+        v1 = glm::ivec3(x, y, z + 1);
+        v2 = glm::ivec3(x + dx, y, z + 1);
+        v3 = glm::ivec3(x + dx, y + dy, z + 1);
+        v4 = glm::ivec3(x, y + dy, z + 1);
+        break;
+    default:
+        return;
+    }
+
+    uint32_t baseIndex = static_cast<uint32_t>(vertices.size());
+    uint8_t blockId = static_cast<uint8_t>(type);
+    vertices.push_back(ChunkVertex::pack(v1.x, v1.y, v1.z, faceIndex, blockId, light));
+    vertices.push_back(ChunkVertex::pack(v2.x, v2.y, v2.z, faceIndex, blockId, light));
+    vertices.push_back(ChunkVertex::pack(v3.x, v3.y, v3.z, faceIndex, blockId, light));
+    vertices.push_back(ChunkVertex::pack(v4.x, v4.y, v4.z, faceIndex, blockId, light));
+
+    indices.push_back(baseIndex);
+    indices.push_back(baseIndex + 1);
+    indices.push_back(baseIndex + 2);
+    indices.push_back(baseIndex + 2);
+    indices.push_back(baseIndex + 3);
+    indices.push_back(baseIndex);
+}
+
+} // namespace voxl
@@ -0,0 +1,217 @@
+#include "chunk_section.h"
+
+#include <algorithm>
+
+namespace voxl {
+
+ChunkSection::ChunkSection(BlockType fill)
+{
+	this->fill(fill);
+}
+
+void ChunkSection::fill(BlockType type)
+{
+	m_palette.assign(1, type);
+	m_counts.assign(1, VOLUME);
+	m_data.clear();
+	m_data.shrink_to_fit();
+	m_bitsPerEntry = 0;
+}
+
+void ChunkSection::set(int x, int y, int z, BlockType type)
+{
+	if (m_bitsPerEntry == 0) {
+		if (m_palette[0] == type) {
+			return;
+		}
+		resize(1);
+	}
+
+	int i = index(x, y, z);
+	uint32_t oldIndex = readIndex(i);
+	if (m_palette[oldIndex] == type) {
+		return;
+	}
+
+	uint32_t newIndex = findOrAddPalette(type);
+	writeIndex(i, newIndex);
+	m_counts[oldIndex]--;
+	m_counts[newIndex]++;
+
+	// Collapse back to a single value once one type fills the whole section
+	if (m_counts[newIndex] == VOLUME) {
+		fill(type);
+	}
+}
+
+void ChunkSection::load(const BlockType* blocks)
+{
+	uint32_t counts[256] = {};
+	for (int i = 0; i < VOLUME; i++) {
+		counts[static_cast<uint8_t>(blocks[i])]++;
+	}
+
+	// Palette of the types actually present, in id order
+	uint32_t paletteIndex[256];
+	m_palette.clear();
+	m_counts.clear();
+	for (int type = 0; type < 256; type++) {
+		if (counts[type] > 0) {
+			paletteIndex[type] = static_cast<uint32_t>(m_palette.size());
+			m_palette.push_back(static_cast<BlockType>(type));
+			m_counts.push_back(counts[type]);
+		}
+	}
+
+	if (m_palette.size() == 1) {
+		fill(m_palette[0]);
+		return;
+	}
+
+	int bitsPerEntry = 1;
+	while (m_palette.size() > (1ull << bitsPerEntry)) {
+		bitsPerEntry *= 2;
+	}
+	m_bitsPerEntry = 0;
+	resize(bitsPerEntry);
+
+	// Whole words at a time, the buffer is freshly zeroed
+	int perWord = 64 / bitsPerEntry;
+	for (size_t word = 0; word < m_data.size(); word++) {
+		const BlockType* entries = blocks + word * perWord;
+		uint64_t packed = 0;
+		for (int i = 0; i < perWord; i++) {
+			packed |= static_cast<uint64_t>(paletteIndex[static_cast<uint8_t>(entries[i])]) << (i * bitsPerEntry);
+		}
+		m_data[word] = packed;
+	}
+}
+
+void ChunkSection::store(BlockType* blocks) const
+{
+	if (m_bitsPerEntry == 0) {
+		std::fill_n(blocks, VOLUME, m_palette[0]);
+		return;
+	}
+	for (int i = 0; i < VOLUME; i++) {
+		blocks[i] = m_palette[readIndex(i)];
+	}
+}
+
+int ChunkSection::getCount(BlockType type) const
+{
+	int count = 0;
+	for (size_t i = 0; i < m_palette.size(); i++) {
+		if (m_palette[i] == type) {
+			count += m_counts[i];
+		}
+	}
+	return count;
+}
+
+int ChunkSection::getOpaqueCount() const
+{
+	int count = 0;
+	for (size_t i = 0; i < m_palette.size(); i++) {
+		if (isOpaque(m_palette[i])) {
+			count += m_counts[i];
+		}
+	}
+	return count;
+}
+
+int ChunkSection::getPaletteSize() const
+{
+	int size = 0;
+	for (uint32_t count : m_counts) {
+		if (count > 0) {
+			size++;
+		}
+	}
+	return size;
+}
+
+size_t ChunkSection::getMemoryUsage() const
+{
+	return sizeof(ChunkSection) +
+		m_palette.capacity() * sizeof(BlockType) +
+		m_counts.capacity() * sizeof(uint32_t) +
+		m_data.capacity() * sizeof(uint64_t);
+}
+
+void ChunkSection::writeIndex(int i, uint32_t value)
+{
+	int perWord = 64 / m_bitsPerEntry;
+	int shift = (i % perWord) * m_bitsPerEntry;
+	uint64_t mask = ((1ull << m_bitsPerEntry) - 1) << shift;
+	uint64_t& word = m_data[i / perWord];
+	word = (word & ~mask) | (static_cast<uint64_t>(value) << shift);
+}
+
+int ChunkSection::findOrAddPalette(BlockType type)
+{
+	int freeSlot = -1;
+	for (int i = 0; i < static_cast<int>(m_palette.size()); i++) {
+		if (m_counts[i] > 0 && m_palette[i] == type) {
+			return i;
+		}
+		if (m_counts[i] == 0 && freeSlot < 0) {
+			freeSlot = i;
+		}
+	}
+
+	// Reuse an entry no voxel refers to anymore
+	if (freeSlot >= 0) {
+		m_palette[freeSlot] = type;
+		return freeSlot;
+	}
+
+	m_palette.push_back(type);
+	m_counts.push_back(0);
+	if (m_palette.size() > (1ull << m_bitsPerEntry)) {
+		resize(m_bitsPerEntry * 2);
+	}
+	return static_cast<int>(m_palette.size()) - 1;
+}
+
+void ChunkSection::resize(int bitsPerEntry)
+{
+	// Entries never straddle two words, so only power of two widths are used
+	std::vector<uint64_t> data(VOLUME / (64 / bitsPerEntry), 0);
+	int oldBits = m_bitsPerEntry;
+	std::swap(m_data, data);
+	m_bitsPerEntry = bitsPerEntry;
+
+	if (oldBits == 0) {
+		return;
+	}
+
+	int oldPerWord = 64 / oldBits;
+	uint64_t oldMask = (1ull << oldBits) - 1;
+	for (int i = 0; i < VOLUME; i++) {
+		uint32_t value = static_cast<uint32_t>((data[i / oldPerWord] >> ((i % oldPerWord) * oldBits)) & oldMask);
+		if (value != 0) {
+			writeIndex(i, value);
+		}
+	}
+}
+
+void LightSection::set(int x, int y, int z, uint8_t light)
+{
+	if (m_data.empty()) {
+		if (light == m_fill) {
+			return;
+		}
+		m_data.assign(ChunkSection::VOLUME, m_fill);
+	}
+	m_data[ChunkSection::index(x, y, z)] = light;
+}
+
+void LightSection::fill(uint8_t light)
+{
+	m_fill = light;
+	m_data.clear();
+	m_data.shrink_to_fit();
+}
+
+} // namespace voxl
@@ -0,0 +1,67 @@
+#include "chunk_streamer.h"
+
+#include <algorithm>
+
+namespace voxl {
+
+ChunkStreamer::ChunkStreamer(int loadRadius, int unloadRadius)
+	: m_loadRadius(loadRadius), m_unloadRadius(unloadRadius)
+{
+}
+
+bool ChunkStreamer::update(const glm::ivec3& playerChunk, const glm::vec3& viewDirection, const ChunkGrid& loaded)
+{
+	glm::vec2 view(viewDirection.x, viewDirection.z);
+	view = glm::length(view) > 0.0f ? glm::normalize(view) : glm::vec2(0.0f);
+
+	if (m_hasPlayerChunk && playerChunk == m_playerChunk) {
+		// Same chunk, only re-sort what is left when the camera turned noticeably
+		if (!m_loadQueue.empty() && glm::dot(view, m_viewDirection) < 0.7f) {
+			m_viewDirection = view;
+			sortQueue();
+		}
+		return false;
+	}
+
+	m_hasPlayerChunk = true;
+	m_playerChunk = playerChunk;
+	m_viewDirection = view;
+
+	m_loadQueue.clear();
+	for (int x = playerChunk.x - m_loadRadius; x <= playerChunk.x + m_loadRadius; x++) {
+		for (int z = playerChunk.z - m_loadRadius; z <= playerChunk.z + m_loadRadius; z++) {
+			glm::ivec3 chunkPos(x, 0, z);
+			if (!loaded.contains(chunkPos)) {
+				m_loadQueue.push_back(chunkPos);
+			}
+		}
+	}
+	sortQueue();
+	return true;
+}
+
+glm::ivec3 ChunkStreamer::popNext()
+{
+	glm::ivec3 chunkPos = m_loadQueue.back();
+	m_loadQueue.pop_back();
+	return chunkPos;
+}
+
+float ChunkStreamer::getPriority(const glm::ivec3& chunkPos) const
+{
+	glm::vec2 offset(chunkPos.x - m_playerChunk.x, chunkPos.z - m_playerChunk.z);
+	float distance = glm::length(offset);
+	if (distance == 0.0f) {
+		return 0.0f;
+	}
+	return distance * (1.0f - VIEW_WEIGHT * glm::dot(offset / distance, m_viewDirection));
+}
+
+void ChunkStreamer::sortQueue()
+{
+	std::sort(m_loadQueue.begin(), m_loadQueue.end(), [this](const glm::ivec3& a, const glm::ivec3& b) {
+		return getPriority(a) > getPriority(b);
+	});
+}
+
+} // namespace voxl
@@ -0,0 +1,322 @@
+#include "light_engine.h"
+#include "chunk_manager.h"
+
+#include <algorithm>
+
+namespace voxl {
+
+namespace {
+
+const int CHUNK_MASK = Chunk::CHUNK_SIZE - 1;
+
+// Same order as the mesher's face directions
+const glm::ivec3 DIRECTIONS[6] = {
+	glm::ivec3(-1, 0, 0), glm::ivec3(1, 0, 0),
+	glm::ivec3(0, -1, 0), glm::ivec3(0, 1, 0),
+	glm::ivec3(0, 0, -1), glm::ivec3(0, 0, 1)
+};
+const int DOWN = 2;
+
+// Height of the highest block of a column that is not air, -1 for a column of air
+int getColumnTop(const Chunk& chunk, int x, int z)
+{
+	for (int section = Chunk::SECTION_COUNT - 1; section >= 0; section--) {
+		const ChunkSection& blocks = chunk.getSection(section);
+		if (blocks.isEmpty()) {
+			continue;
+		}
+		int baseY = section * ChunkSection::SIZE;
+		if (blocks.isUniform()) {
+			return baseY + ChunkSection::SIZE - 1;
+		}
+		for (int y = ChunkSection::SIZE - 1; y >= 0; y--) {
+			if (blocks.get(x, y, z) != BlockType::None) {
+				return baseY + y;
+			}
+		}
+	}
+	return -1;
+}
+
+bool hasEmitters(const ChunkSection& blocks)
+{
+	for (int type = 0; type < BLOCK_TYPE_COUNT; type++) {
+		if (getLightEmission(static_cast<BlockType>(type)) > 0 && blocks.getCount(static_cast<BlockType>(type)) > 0) {
+			return true;
+		}
+	}
+	return false;
+}
+
+} // namespace
+
+LightEngine::LightEngine(const ChunkManager& chunkManager)
+	: m_view(chunkManager, ChunkStage::Lit)
+{
+}
+
+void LightEngine::setLevel(Chunk& chunk, const glm::ivec3& pos, int channel, int level)
+{
+	int x = pos.x & CHUNK_MASK;
+	int z = pos.z & CHUNK_MASK;
+	chunk.setLight(x, pos.y, z, withLevel(chunk.getLight(x, pos.y, z), channel, level));
+	if (chunk.getStage() == ChunkStage::Meshed) {
+		m_changed.push_back(pos);
+	}
+}
+
+void LightEngine::lightChunk(const glm::ivec3& chunkPos)
+{
+	const int size = Chunk::CHUNK_SIZE;
+	const int originX = chunkPos.x * size;
+	const int originZ = chunkPos.z * size;
+	m_view.reset();
+	Chunk* chunk = m_view.getChunkAt(originX, originZ);
+	if (chunk == nullptr) {
+		return;
+	}
+
+	// Column tops of the chunk and of the lit columns bordering it, -1 where no sky light has to
+	// be pushed sideways. Indexed (x + 1) * (size + 2) + (z + 1) in chunk local coordinates.
+	const int side = size + 2;
+	std::vector<int> tops(side * side, -1);
+	int maxTop = -1;
+	for (int x = -1; x <= size; x++) {
+		for (int z = -1; z <= size; z++) {
+			bool insideX = x >= 0 && x < size;
+			bool insideZ = z >= 0 && z < size;
+			if (!insideX && !insideZ) {
+				continue; // Corners don't touch the chunk
+			}
+			const Chunk* column = m_view.getChunkAt(originX + x, originZ + z);
+			if (column != nullptr) {
+				int top = getColumnTop(*column, (originX + x) & CHUNK_MASK, (originZ + z) & CHUNK_MASK);
+				tops[(x + 1) * side + (z + 1)] = top;
+				if (insideX && insideZ) {
+					maxTop = std::max(maxTop, top);
+				}
+			}
+		}
+	}
+
+	// Open sky over every column, sections above all of them stay a single value
+	const int skyStart = maxTop < 0 ? 0 : (maxTop / ChunkSection::SIZE + 1) * ChunkSection::SIZE;
+	for (int section = 0; section < Chunk::SECTION_COUNT; section++) {
+		bool open = section * ChunkSection::SIZE >= skyStart;
+		chunk->getLightSection(section).fill(open ? LightSection::pack(MAX_LIGHT_LEVEL, 0) : 0);
+	}
+
+	std::vector<glm::ivec3>& skyQueue = m_addQueues[Sky];
+	for (int x = 0; x < size; x++) {
+		for (int z = 0; z < size; z++) {
+			int top = tops[(x + 1) * side + (z + 1)];
+			for (int y = top + 1; y < skyStart; y++) {
+				chunk->setLight(x, y, z, LightSection::pack(MAX_LIGHT_LEVEL, 0));
+			}
+
+			// Sky light only has to spread from the part of the column next to higher columns,
+			// and from just above the top in case the top block lets light through
+			int highest = top + 1;
+			for (int d : { 0, 1, 4, 5 }) {
+				highest = std::max(highest, tops[(x + 1 + DIRECTIONS[d].x) * side + (z + 1 + DIRECTIONS[d].z)]);
+			}
+			for (int y = top + 1; y <= std::min(highest, Chunk::CHUNK_HEIGHT - 1); y++) {
+				skyQueue.push_back(glm::ivec3(originX + x, y, originZ + z));
+			}
+		}
+	}
+
+	// Light sources, only sections that have one are scanned
+	for (int section = 0; section < Chunk::SECTION_COUNT; section++) {
+		const ChunkSection& blocks = chunk->getSection(section);
+		if (!hasEmitters(blocks)) {
+			continue;
+		}
+		for (int x = 0; x < size; x++) {
+			for (int z = 0; z < size; z++) {
+				for (int y = 0; y < ChunkSection::SIZE; y++) {
+					int emission = getLightEmission(blocks.get(x, y, z));
+					if (emission > 0) {
+						glm::ivec3 pos(originX + x, section * ChunkSection::SIZE + y, originZ + z);
+						setLevel(*chunk, pos, Block, emission);
+						m_addQueues[Block].push_back(pos);
+					}
+				}
+			}
+		}
+	}
+
+	// Light of the lit neighbors that can flow in across the borders
+	for (int d : { 0, 1, 4, 5 }) {
+		const glm::ivec3& direction = DIRECTIONS[d];
+		const Chunk* neighbor = m_view.getChunkAt(originX + direction.x * size, originZ + direction.z * size);
+		if (neighbor == nullptr) {
+			continue;
+		}
+		for (int i = 0; i < size; i++) {
+			// Border column of the chunk and the column of the neighbor facing it
+			int x = direction.x < 0 ? 0 : (direction.x > 0 ? size - 1 : i);
+			int z = direction.z < 0 ? 0 : (direction.z > 0 ? size - 1 : i);
+			int outerX = (x + direction.x) & CHUNK_MASK;
+			int outerZ = (z + direction.z) & CHUNK_MASK;
+			for (int y = 0; y < Chunk::CHUNK_HEIGHT; y++) {
+				uint8_t outer = neighbor->getLight(outerX, y, outerZ);
+				if (outer == 0) {
+					continue;
+				}
+				int absorption = getLightAbsorption(chunk->getBlockType(x, y, z));
+				uint8_t inner = chunk->getLight(x, y, z);
+				for (int channel : { Sky, Block }) {
+					if (getLevel(outer, channel) - 1 - absorption > getLevel(inner, channel)) {
+						m_addQueues[channel].push_back(glm::ivec3(originX + x + direction.x, y, originZ + z + direction.z));
+					}
+				}
+			}
+		}
+	}
+
+	propagate(Sky);
+	propagate(Block);
+}
+
+void LightEngine::updateBlock(const glm::ivec3& block)
+{
+	if (block.y < 0 || block.y >= Chunk::CHUNK_HEIGHT) {
+		return;
+	}
+	m_view.reset();
+	Chunk* chunk = m_view.getChunkAt(block.x, block.z);
+	if (chunk == nullptr) {
+		return; // Not lit yet, it gets the new block when it is
+	}
+	int x = block.x & CHUNK_MASK;
+	int z = block.z & CHUNK_MASK;
+	BlockType type = chunk->getBlockType(x, block.y, z);
+
+	// Take back everything the voxel lit, the voxels at the rim of the dark area are queued to refill it
+	uint8_t light = chunk->getLight(x, block.y, z);
+	for (int channel : { Sky, Block }) {
+		int level = getLevel(light, channel);
+		if (level > 0) {
+			setLevel(*chunk, block, channel, 0);
+			m_removeQueues[channel].push_back({ block, level });
+			unpropagate(channel);
+		}
+	}
+
+	int emission = getLightEmission(type);
+	if (emission > 0) {
+		setLevel(*chunk, block, Block, emission);
+		m_addQueues[Block].push_back(block);
+	}
+
+	int absorption = getLightAbsorption(type);
+	if (absorption < MAX_LIGHT_LEVEL) {
+		// Nothing above the world blocks the sky
+		if (block.y == Chunk::CHUNK_HEIGHT - 1) {
+			setLevel(*chunk, block, Sky, absorption == 0 ? MAX_LIGHT_LEVEL : MAX_LIGHT_LEVEL - 1 - absorption);
+			m_addQueues[Sky].push_back(block);
+		}
+
+		// Light around the voxel flows back in
+		for (const glm::ivec3& direction : DIRECTIONS) {
+			glm::ivec3 next = block + direction;
+			if (next.y >= 0 && next.y < Chunk::CHUNK_HEIGHT && m_view.getChunkAt(next.x, next.z) != nullptr) {
+				m_addQueues[Sky].push_back(next);
+				m_addQueues[Block].push_back(next);
+			}
+		}
+	}
+
+	propagate(Sky);
+	propagate(Block);
+}
+
+void LightEngine::propagate(int channel)
+{
+	std::vector<glm::ivec3>& queue = m_addQueues[channel];
+	for (size_t head = 0; head < queue.size(); head++)
+	{
+		glm::ivec3 pos = queue[head];
+		const Chunk* chunk = m_view.getChunkAt(pos.x, pos.z);
+		if (chunk == nullptr) {
+			continue;
+		}
+		int level = getLevel(chunk->getLight(pos.x & CHUNK_MASK, pos.y, pos.z & CHUNK_MASK), channel);
+		if (level <= 1) {
+			continue;
+		}
+
+		for (int d = 0; d < 6; d++) {
+			glm::ivec3 next = pos + DIRECTIONS[d];
+			if (next.y < 0 || next.y >= Chunk::CHUNK_HEIGHT) {
+				continue;
+			}
+			Chunk* nextChunk = m_view.getChunkAt(next.x, next.z);
+			if (nextChunk == nullptr) {
+				continue;
+			}
+			int x = next.x & CHUNK_MASK;
+			int z = next.z & CHUNK_MASK;
+			int absorption = getLightAbsorption(nextChunk->getBlockType(x, next.y, z));
+			if (absorption >= MAX_LIGHT_LEVEL) {
+				continue;
+			}
+
+			bool skyColumn = channel == Sky && d == DOWN && level == MAX_LIGHT_LEVEL && absorption == 0;
+			int nextLevel = skyColumn ? MAX_LIGHT_LEVEL : level - 1 - absorption;
+			if (nextLevel > getLevel(nextChunk->getLight(x, next.y, z), channel)) {
+				setLevel(*nextChunk, next, channel, nextLevel);
+				queue.push_back(next);
+			}
+		}
+	}
+	queue.clear();
+}
+
+void LightEngine::unpropagate(int channel)
+{
+	// A neighbor dimmer than the light removed may have been lit by it, so it goes dark too.
+	// Anything at least as bright has another source and lights the dark area back up.
+	std::vector<RemovedLight>& queue = m_removeQueues[channel];
+	std::vector<glm::ivec3>& refill = m_addQueues[channel];
+	for (size_t head = 0; head < queue.size(); head++)
+	{
+		RemovedLight removed = queue[head];
+		for (int d = 0; d < 6; d++) {
+			glm::ivec3 next = removed.pos + DIRECTIONS[d];
+			if (next.y < 0 || next.y >= Chunk::CHUNK_HEIGHT) {
+				continue;
+			}
+			Chunk* nextChunk = m_view.getChunkAt(next.x, next.z);
+			if (nextChunk == nullptr) {
+				continue;
+			}
+			int x = next.x & CHUNK_MASK;
+			int z = next.z & CHUNK_MASK;
+			int level = getLevel(nextChunk->getLight(x, next.y, z), channel);
+			if (level == 0) {
+				continue;
+			}
+
+			bool skyColumn = channel == Sky && d == DOWN && removed.level == MAX_LIGHT_LEVEL && level == MAX_LIGHT_LEVEL;
+			if (level < removed.level || skyColumn) {
+				setLevel(*nextChunk, next, channel, 0);
+				queue.push_back({ next, level });
+
+				// A light source keeps shining
+				int emission = channel == Block ? getLightEmission(nextChunk->getBlockType(x, next.y, z)) : 0;
+				if (emission > 0) {
+					setLevel(*nextChunk, next, channel, emission);
+					refill.push_back(next);
+				}
+			}
+			else {
+				refill.push_back(next);
+			}
+		}
+	}
+	queue.clear();
+}
+
+} // namespace voxl
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <iostream>
 
 #include "renderer.h"
@@ -16,12 +17,14 @@ void mouseCallback(GLFWwindow* window, double xpos, double ypos);
 int main() {
 	// Initialization
 	voxl::Renderer renderer;
-	voxl::ChunkManager chunkManager;
+	voxl::ChunkManager chunkManager("world");
 
 	voxl::Camera camera(window_width, window_height, glm::vec3(0.0f, 1.0f, 0.0f), -90.0f, 0.0f);
 
-	voxl::Player player(glm::vec3(0.0f, 30.0f, 2.0f), camera, chunkManager);
-	
+	// Spawn standing on the terrain, or on the water where it is flooded
+	int spawnHeight = std::max(chunkManager.getTerrain().getSurfaceHeight(0, 2) + 1, voxl::TerrainCache::WATER_HEIGHT);
+	voxl::Player player(glm::vec3(0.0f, static_cast<float>(spawnHeight), 2.0f), camera, chunkManager);
+
 
 	// Window settings
 	glfwSetCursorPosCallback(renderer.window, mouseCallback);
@@ -40,11 +43,13 @@ int main() {
 		deltaTime = currentFrame - lastFrame;
 		lastFrame = currentFrame;
 
-		// Player update
-		player.update(deltaTime);
+		// Player update, held in place until the chunk under them has streamed in
+		if (chunkManager.isReady(player.getPosition())) {
+			player.update(deltaTime);
+		}
 
 		// ChunkManager update
-		chunkManager.updateChunks(player.getPosition());
+		chunkManager.updateChunks(player.getPosition(), camera.getForward());
 
 		renderer.updateLighting(player.getPosition(), deltaTime);
 
@@ -53,6 +58,7 @@ int main() {
 
 		
 	}
+	chunkManager.saveChunks();
 	renderer.clear();
 	return 0;
 }
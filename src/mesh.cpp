@@ -1,6 +1,7 @@
 #include "mesh.h"
 #include "glad/glad.h"
 #include <iostream>
+#include <utility>
 
 namespace voxl {
 
@@ -14,10 +15,18 @@ Mesh::Mesh()
 
 Mesh::Mesh(std::vector<glm::vec3> vertices, std::vector<glm::vec3> normals, std::vector<unsigned int> indices, std::vector<glm::vec4> colors)
 {
-	this->vertices = vertices;
-	this->normals = normals;
-	this->indices = indices;
-	this->colors = colors;
+	this->vertices = std::move(vertices);
+	this->normals = std::move(normals);
+	this->indices = std::move(indices);
+	this->colors = std::move(colors);
+	generateBuffers();
+}
+
+Mesh::Mesh(std::vector<ChunkVertex> vertices, std::vector<unsigned int> indices)
+{
+	this->packedVertices = std::move(vertices);
+	this->indices = std::move(indices);
+	isPacked = true;
 	generateBuffers();
 }
 
@@ -32,10 +41,35 @@ Mesh::~Mesh()
 
 void Mesh::generateBuffers()
 {
+    indexCount = static_cast<unsigned int>(indices.size());
+
     // Generate and bind VAO
     glGenVertexArrays(1, &VAO);
     glBindVertexArray(VAO);
 
+    if (isPacked)
+    {
+        // Single interleaved buffer of packed vertices, decoded in the vertex shader (location 0)
+        glGenBuffers(1, &VBO);
+        glBindBuffer(GL_ARRAY_BUFFER, VBO);
+        glBufferData(GL_ARRAY_BUFFER, packedVertices.size() * sizeof(ChunkVertex), packedVertices.data(), GL_STATIC_DRAW);
+
+        glEnableVertexAttribArray(0);
+        glVertexAttribIPointer(0, 2, GL_UNSIGNED_INT, sizeof(ChunkVertex), (void*)0);
+
+        glGenBuffers(1, &EBO);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
+
+        glBindVertexArray(0);
+
+        // The GPU holds the mesh now, chunk meshes are rebuilt from voxels rather than edited
+        gpuBytes = packedVertices.size() * sizeof(ChunkVertex) + indices.size() * sizeof(unsigned int);
+        packedVertices = std::vector<ChunkVertex>();
+        indices = std::vector<unsigned int>();
+        return;
+    }
+
     // Generate and bind vertex buffer
     glGenBuffers(1, &VBO);
     glBindBuffer(GL_ARRAY_BUFFER, VBO);
@@ -71,6 +105,9 @@ void Mesh::generateBuffers()
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
     glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
 
+    gpuBytes = vertices.size() * sizeof(glm::vec3) + normals.size() * sizeof(glm::vec3) +
+        (CBO != 0 ? colors.size() * sizeof(glm::vec4) : 0) + indices.size() * sizeof(unsigned int);
+
     GLenum err;
     while ((err = glGetError()) != GL_NO_ERROR) {
         std::cout << "OpenGL error: " << err << std::endl;
@@ -80,8 +117,37 @@ void Mesh::generateBuffers()
     glBindVertexArray(0);
 }
 
+OcclusionMap::OcclusionMap(const std::vector<uint32_t>& columns, int size)
+{
+	glGenTextures(1, &texture);
+	glBindTexture(GL_TEXTURE_2D, texture);
+	// Integer textures can't be filtered, they are incomplete unless sampled nearest
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RG32UI, size, size, 0, GL_RG_INTEGER, GL_UNSIGNED_INT, columns.data());
+	glBindTexture(GL_TEXTURE_2D, 0);
+	gpuBytes = columns.size() * sizeof(uint32_t);
+}
+
+OcclusionMap::~OcclusionMap()
+{
+	glDeleteTextures(1, &texture);
+}
+
+size_t Mesh::getMemoryUsage() const
+{
+	size_t cpuBytes = vertices.capacity() * sizeof(glm::vec3) + normals.capacity() * sizeof(glm::vec3) +
+		colors.capacity() * sizeof(glm::vec4) + indices.capacity() * sizeof(unsigned int) +
+		packedVertices.capacity() * sizeof(ChunkVertex);
+	return cpuBytes + gpuBytes;
+}
+
 void Mesh::setColors(std::vector<glm::vec4> colors)
 {
+	if (CBO != 0) {
+		gpuBytes -= this->colors.size() * sizeof(glm::vec4);
+		gpuBytes += colors.size() * sizeof(glm::vec4);
+	}
 	this->colors = colors;
 	glBindVertexArray(VAO);
 	// Update color buffer
@@ -0,0 +1,276 @@
+#include "perlin_noise.h"
+
+#include <cstdint>
+
+#if defined(__AVX2__)
+#define VOXL_AVX2
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define VOXL_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace voxl {
+
+namespace {
+
+// Constants and gradient table of FastNoiseLite, the output has to match it exactly
+const uint32_t PRIME_X = 501125321u;
+const uint32_t PRIME_Z = 1136930381u;
+const uint32_t HASH_MULTIPLIER = 0x27d4eb2du;
+const float PERLIN_SCALE = 1.4247691104677813f;
+
+alignas(32) const float GRADIENTS[256] = {
+	0.130526192220052f, 0.99144486137381f, 0.38268343236509f, 0.923879532511287f, 0.608761429008721f, 0.793353340291235f, 0.793353340291235f, 0.608761429008721f,
+	0.923879532511287f, 0.38268343236509f, 0.99144486137381f, 0.130526192220051f, 0.99144486137381f, -0.130526192220051f, 0.923879532511287f, -0.38268343236509f,
+	0.793353340291235f, -0.60876142900872f, 0.608761429008721f, -0.793353340291235f, 0.38268343236509f, -0.923879532511287f, 0.130526192220052f, -0.99144486137381f,
+	-0.130526192220052f, -0.99144486137381f, -0.38268343236509f, -0.923879532511287f, -0.608761429008721f, -0.793353340291235f, -0.793353340291235f, -0.608761429008721f,
+	-0.923879532511287f, -0.38268343236509f, -0.99144486137381f, -0.130526192220052f, -0.99144486137381f, 0.130526192220051f, -0.923879532511287f, 0.38268343236509f,
+	-0.793353340291235f, 0.608761429008721f, -0.608761429008721f, 0.793353340291235f, -0.38268343236509f, 0.923879532511287f, -0.130526192220052f, 0.99144486137381f,
+	0.130526192220052f, 0.99144486137381f, 0.38268343236509f, 0.923879532511287f, 0.608761429008721f, 0.793353340291235f, 0.793353340291235f, 0.608761429008721f,
+	0.923879532511287f, 0.38268343236509f, 0.99144486137381f, 0.130526192220051f, 0.99144486137381f, -0.130526192220051f, 0.923879532511287f, -0.38268343236509f,
+	0.793353340291235f, -0.60876142900872f, 0.608761429008721f, -0.793353340291235f, 0.38268343236509f, -0.923879532511287f, 0.130526192220052f, -0.99144486137381f,
+	-0.130526192220052f, -0.99144486137381f, -0.38268343236509f, -0.923879532511287f, -0.608761429008721f, -0.793353340291235f, -0.793353340291235f, -0.608761429008721f,
+	-0.923879532511287f, -0.38268343236509f, -0.99144486137381f, -0.130526192220052f, -0.99144486137381f, 0.130526192220051f, -0.923879532511287f, 0.38268343236509f,
+	-0.793353340291235f, 0.608761429008721f, -0.608761429008721f, 0.793353340291235f, -0.38268343236509f, 0.923879532511287f, -0.130526192220052f, 0.99144486137381f,
+	0.130526192220052f, 0.99144486137381f, 0.38268343236509f, 0.923879532511287f, 0.608761429008721f, 0.793353340291235f, 0.793353340291235f, 0.608761429008721f,
+	0.923879532511287f, 0.38268343236509f, 0.99144486137381f, 0.130526192220051f, 0.99144486137381f, -0.130526192220051f, 0.923879532511287f, -0.38268343236509f,
+	0.793353340291235f, -0.60876142900872f, 0.608761429008721f, -0.793353340291235f, 0.38268343236509f, -0.923879532511287f, 0.130526192220052f, -0.99144486137381f,
+	-0.130526192220052f, -0.99144486137381f, -0.38268343236509f, -0.923879532511287f, -0.608761429008721f, -0.793353340291235f, -0.793353340291235f, -0.608761429008721f,
+	-0.923879532511287f, -0.38268343236509f, -0.99144486137381f, -0.130526192220052f, -0.99144486137381f, 0.130526192220051f, -0.923879532511287f, 0.38268343236509f,
+	-0.793353340291235f, 0.608761429008721f, -0.608761429008721f, 0.793353340291235f, -0.38268343236509f, 0.923879532511287f, -0.130526192220052f, 0.99144486137381f,
+	0.130526192220052f, 0.99144486137381f, 0.38268343236509f, 0.923879532511287f, 0.608761429008721f, 0.793353340291235f, 0.793353340291235f, 0.608761429008721f,
+	0.923879532511287f, 0.38268343236509f, 0.99144486137381f, 0.130526192220051f, 0.99144486137381f, -0.130526192220051f, 0.923879532511287f, -0.38268343236509f,
+	0.793353340291235f, -0.60876142900872f, 0.608761429008721f, -0.793353340291235f, 0.38268343236509f, -0.923879532511287f, 0.130526192220052f, -0.99144486137381f,
+	-0.130526192220052f, -0.99144486137381f, -0.38268343236509f, -0.923879532511287f, -0.608761429008721f, -0.793353340291235f, -0.793353340291235f, -0.608761429008721f,
+	-0.923879532511287f, -0.38268343236509f, -0.99144486137381f, -0.130526192220052f, -0.99144486137381f, 0.130526192220051f, -0.923879532511287f, 0.38268343236509f,
+	-0.793353340291235f, 0.608761429008721f, -0.608761429008721f, 0.793353340291235f, -0.38268343236509f, 0.923879532511287f, -0.130526192220052f, 0.99144486137381f,
+	0.130526192220052f, 0.99144486137381f, 0.38268343236509f, 0.923879532511287f, 0.608761429008721f, 0.793353340291235f, 0.793353340291235f, 0.608761429008721f,
+	0.923879532511287f, 0.38268343236509f, 0.99144486137381f, 0.130526192220051f, 0.99144486137381f, -0.130526192220051f, 0.923879532511287f, -0.38268343236509f,
+	0.793353340291235f, -0.60876142900872f, 0.608761429008721f, -0.793353340291235f, 0.38268343236509f, -0.923879532511287f, 0.130526192220052f, -0.99144486137381f,
+	-0.130526192220052f, -0.99144486137381f, -0.38268343236509f, -0.923879532511287f, -0.608761429008721f, -0.793353340291235f, -0.793353340291235f, -0.608761429008721f,
+	-0.923879532511287f, -0.38268343236509f, -0.99144486137381f, -0.130526192220052f, -0.99144486137381f, 0.130526192220051f, -0.923879532511287f, 0.38268343236509f,
+	-0.793353340291235f, 0.608761429008721f, -0.608761429008721f, 0.793353340291235f, -0.38268343236509f, 0.923879532511287f, -0.130526192220052f, 0.99144486137381f,
+	0.38268343236509f, 0.923879532511287f, 0.923879532511287f, 0.38268343236509f, 0.923879532511287f, -0.38268343236509f, 0.38268343236509f, -0.923879532511287f,
+	-0.38268343236509f, -0.923879532511287f, -0.923879532511287f, -0.38268343236509f, -0.923879532511287f, 0.38268343236509f, -0.38268343236509f, 0.923879532511287f,
+};
+
+// Same rounding as _fnlFastFloor, which is one off for negative whole numbers
+int fastFloor(float f) { return f >= 0 ? static_cast<int>(f) : static_cast<int>(f) - 1; }
+
+float interpQuintic(float t) { return t * t * t * (t * (t * 6 - 15) + 10); }
+float lerp(float a, float b, float t) { return a + t * (b - a); }
+
+int gradientIndex(int seed, uint32_t xPrimed, uint32_t zPrimed)
+{
+	int32_t hash = static_cast<int32_t>((static_cast<uint32_t>(seed) ^ xPrimed ^ zPrimed) * HASH_MULTIPLIER);
+	hash ^= hash >> 15;
+	return hash & (127 << 1);
+}
+
+float gradient(int seed, uint32_t xPrimed, uint32_t zPrimed, float xd, float zd)
+{
+	int index = gradientIndex(seed, xPrimed, zPrimed);
+	return xd * GRADIENTS[index] + zd * GRADIENTS[index | 1];
+}
+
+// The x terms of one grid row, shared by every sample in it
+struct RowTerms {
+	float xd0, xd1, xs;
+	uint32_t x0, x1;
+};
+
+RowTerms getRowTerms(int x, float frequency)
+{
+	float fx = static_cast<float>(x) * frequency;
+	int x0 = fastFloor(fx);
+	RowTerms row;
+	row.xd0 = fx - x0;
+	row.xd1 = row.xd0 - 1;
+	row.xs = interpQuintic(row.xd0);
+	row.x0 = static_cast<uint32_t>(x0) * PRIME_X;
+	row.x1 = row.x0 + PRIME_X;
+	return row;
+}
+
+float sampleRow(int seed, const RowTerms& row, int z, float frequency)
+{
+	float fz = static_cast<float>(z) * frequency;
+	int z0 = fastFloor(fz);
+	float zd0 = fz - z0;
+	float zd1 = zd0 - 1;
+	float zs = interpQuintic(zd0);
+	uint32_t z0Primed = static_cast<uint32_t>(z0) * PRIME_Z;
+	uint32_t z1Primed = z0Primed + PRIME_Z;
+
+	float xf0 = lerp(gradient(seed, row.x0, z0Primed, row.xd0, zd0), gradient(seed, row.x1, z0Primed, row.xd1, zd0), row.xs);
+	float xf1 = lerp(gradient(seed, row.x0, z1Primed, row.xd0, zd1), gradient(seed, row.x1, z1Primed, row.xd1, zd1), row.xs);
+	return lerp(xf0, xf1, zs) * PERLIN_SCALE;
+}
+
+#if defined(VOXL_AVX2)
+
+const int LANES = 8;
+
+__m256 gradientLanes(__m256i seedX, __m256i zPrimed, __m256 xd, __m256 zd)
+{
+	__m256i hash = _mm256_mullo_epi32(_mm256_xor_si256(seedX, zPrimed), _mm256_set1_epi32(static_cast<int>(HASH_MULTIPLIER)));
+	hash = _mm256_xor_si256(hash, _mm256_srai_epi32(hash, 15));
+	hash = _mm256_and_si256(hash, _mm256_set1_epi32(127 << 1));
+	__m256 gx = _mm256_i32gather_ps(GRADIENTS, hash, 4);
+	__m256 gz = _mm256_i32gather_ps(GRADIENTS, _mm256_or_si256(hash, _mm256_set1_epi32(1)), 4);
+	return _mm256_add_ps(_mm256_mul_ps(xd, gx), _mm256_mul_ps(zd, gz));
+}
+
+// Same dot product with one corner shared by all lanes, the gradient is looked up once
+__m256 gradientLanes(int index, __m256 xd, __m256 zd)
+{
+	return _mm256_add_ps(_mm256_mul_ps(xd, _mm256_set1_ps(GRADIENTS[index])), _mm256_mul_ps(zd, _mm256_set1_ps(GRADIENTS[index | 1])));
+}
+
+__m256 lerpLanes(__m256 a, __m256 b, __m256 t)
+{
+	return _mm256_add_ps(a, _mm256_mul_ps(t, _mm256_sub_ps(b, a)));
+}
+
+// LANES consecutive samples of a row starting at z. At terrain frequencies the lanes nearly always
+// fall in one lattice cell, then the four corner gradients are hashed once instead of per lane.
+void sampleLanes(int seed, const RowTerms& row, int z, float frequency, float* out)
+{
+	__m256 fz = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_add_epi32(_mm256_set1_epi32(z), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7))),
+		_mm256_set1_ps(frequency));
+	__m256 negative = _mm256_cmp_ps(fz, _mm256_setzero_ps(), _CMP_LT_OQ);
+	__m256i z0 = _mm256_add_epi32(_mm256_cvttps_epi32(fz), _mm256_castps_si256(negative));
+
+	__m256 one = _mm256_set1_ps(1.0f);
+	__m256 zd0 = _mm256_sub_ps(fz, _mm256_cvtepi32_ps(z0));
+	__m256 zd1 = _mm256_sub_ps(zd0, one);
+	__m256 zs = _mm256_mul_ps(_mm256_mul_ps(_mm256_mul_ps(zd0, zd0), zd0),
+		_mm256_add_ps(_mm256_mul_ps(zd0, _mm256_sub_ps(_mm256_mul_ps(zd0, _mm256_set1_ps(6.0f)), _mm256_set1_ps(15.0f))), _mm256_set1_ps(10.0f)));
+
+	__m256i z0Primed = _mm256_mullo_epi32(z0, _mm256_set1_epi32(static_cast<int>(PRIME_Z)));
+	__m256i z1Primed = _mm256_add_epi32(z0Primed, _mm256_set1_epi32(static_cast<int>(PRIME_Z)));
+	__m256i seedX0 = _mm256_set1_epi32(static_cast<int>(static_cast<uint32_t>(seed) ^ row.x0));
+	__m256i seedX1 = _mm256_set1_epi32(static_cast<int>(static_cast<uint32_t>(seed) ^ row.x1));
+	__m256 xd0 = _mm256_set1_ps(row.xd0);
+	__m256 xd1 = _mm256_set1_ps(row.xd1);
+	__m256 xs = _mm256_set1_ps(row.xs);
+
+	__m256 xf0, xf1;
+	int zFirst = fastFloor(static_cast<float>(z) * frequency);
+	int zLast = fastFloor(static_cast<float>(z + LANES - 1) * frequency);
+	if (zFirst == zLast) {
+		uint32_t z0Cell = static_cast<uint32_t>(zFirst) * PRIME_Z;
+		uint32_t z1Cell = z0Cell + PRIME_Z;
+		xf0 = lerpLanes(gradientLanes(gradientIndex(seed, row.x0, z0Cell), xd0, zd0), gradientLanes(gradientIndex(seed, row.x1, z0Cell), xd1, zd0), xs);
+		xf1 = lerpLanes(gradientLanes(gradientIndex(seed, row.x0, z1Cell), xd0, zd1), gradientLanes(gradientIndex(seed, row.x1, z1Cell), xd1, zd1), xs);
+	}
+	else {
+		xf0 = lerpLanes(gradientLanes(seedX0, z0Primed, xd0, zd0), gradientLanes(seedX1, z0Primed, xd1, zd0), xs);
+		xf1 = lerpLanes(gradientLanes(seedX0, z1Primed, xd0, zd1), gradientLanes(seedX1, z1Primed, xd1, zd1), xs);
+	}
+	_mm256_storeu_ps(out, _mm256_mul_ps(lerpLanes(xf0, xf1, zs), _mm256_set1_ps(PERLIN_SCALE)));
+}
+
+#elif defined(VOXL_SSE2)
+
+const int LANES = 4;
+
+// Low 32 bits of each lane product, SSE2 only has the widening unsigned multiply
+__m128i mulLo32(__m128i a, __m128i b)
+{
+	__m128i even = _mm_mul_epu32(a, b);
+	__m128i odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+	return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)), _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+}
+
+__m128 gradientLanes(__m128i seedX, __m128i zPrimed, __m128 xd, __m128 zd)
+{
+	__m128i hash = mulLo32(_mm_xor_si128(seedX, zPrimed), _mm_set1_epi32(static_cast<int>(HASH_MULTIPLIER)));
+	hash = _mm_xor_si128(hash, _mm_srai_epi32(hash, 15));
+	hash = _mm_and_si128(hash, _mm_set1_epi32(127 << 1));
+
+	// No gather before AVX2, the table lookups go through memory
+	alignas(16) int32_t index[4];
+	_mm_store_si128(reinterpret_cast<__m128i*>(index), hash);
+	__m128 gx = _mm_setr_ps(GRADIENTS[index[0]], GRADIENTS[index[1]], GRADIENTS[index[2]], GRADIENTS[index[3]]);
+	__m128 gz = _mm_setr_ps(GRADIENTS[index[0] | 1], GRADIENTS[index[1] | 1], GRADIENTS[index[2] | 1], GRADIENTS[index[3] | 1]);
+	return _mm_add_ps(_mm_mul_ps(xd, gx), _mm_mul_ps(zd, gz));
+}
+
+// Same dot product with one corner shared by all lanes, the gradient is looked up once
+__m128 gradientLanes(int index, __m128 xd, __m128 zd)
+{
+	return _mm_add_ps(_mm_mul_ps(xd, _mm_set1_ps(GRADIENTS[index])), _mm_mul_ps(zd, _mm_set1_ps(GRADIENTS[index | 1])));
+}
+
+__m128 lerpLanes(__m128 a, __m128 b, __m128 t)
+{
+	return _mm_add_ps(a, _mm_mul_ps(t, _mm_sub_ps(b, a)));
+}
+
+// LANES consecutive samples of a row starting at z. At terrain frequencies the lanes nearly always
+// fall in one lattice cell, then the four corner gradients are hashed once instead of per lane.
+void sampleLanes(int seed, const RowTerms& row, int z, float frequency, float* out)
+{
+	__m128 fz = _mm_mul_ps(_mm_cvtepi32_ps(_mm_add_epi32(_mm_set1_epi32(z), _mm_setr_epi32(0, 1, 2, 3))), _mm_set1_ps(frequency));
+	__m128 negative = _mm_cmplt_ps(fz, _mm_setzero_ps());
+	__m128i z0 = _mm_add_epi32(_mm_cvttps_epi32(fz), _mm_castps_si128(negative));
+
+	__m128 one = _mm_set1_ps(1.0f);
+	__m128 zd0 = _mm_sub_ps(fz, _mm_cvtepi32_ps(z0));
+	__m128 zd1 = _mm_sub_ps(zd0, one);
+	__m128 zs = _mm_mul_ps(_mm_mul_ps(_mm_mul_ps(zd0, zd0), zd0),
+		_mm_add_ps(_mm_mul_ps(zd0, _mm_sub_ps(_mm_mul_ps(zd0, _mm_set1_ps(6.0f)), _mm_set1_ps(15.0f))), _mm_set1_ps(10.0f)));
+
+	__m128i z0Primed = mulLo32(z0, _mm_set1_epi32(static_cast<int>(PRIME_Z)));
+	__m128i z1Primed = _mm_add_epi32(z0Primed, _mm_set1_epi32(static_cast<int>(PRIME_Z)));
+	__m128i seedX0 = _mm_set1_epi32(static_cast<int>(static_cast<uint32_t>(seed) ^ row.x0));
+	__m128i seedX1 = _mm_set1_epi32(static_cast<int>(static_cast<uint32_t>(seed) ^ row.x1));
+	__m128 xd0 = _mm_set1_ps(row.xd0);
+	__m128 xd1 = _mm_set1_ps(row.xd1);
+	__m128 xs = _mm_set1_ps(row.xs);
+
+	__m128 xf0, xf1;
+	int zFirst = fastFloor(static_cast<float>(z) * frequency);
+	int zLast = fastFloor(static_cast<float>(z + LANES - 1) * frequency);
+	if (zFirst == zLast) {
+		uint32_t z0Cell = static_cast<uint32_t>(zFirst) * PRIME_Z;
+		uint32_t z1Cell = z0Cell + PRIME_Z;
+		xf0 = lerpLanes(gradientLanes(gradientIndex(seed, row.x0, z0Cell), xd0, zd0), gradientLanes(gradientIndex(seed, row.x1, z0Cell), xd1, zd0), xs);
+		xf1 = lerpLanes(gradientLanes(gradientIndex(seed, row.x0, z1Cell), xd0, zd1), gradientLanes(gradientIndex(seed, row.x1, z1Cell), xd1, zd1), xs);
+	}
+	else {
+		xf0 = lerpLanes(gradientLanes(seedX0, z0Primed, xd0, zd0), gradientLanes(seedX1, z0Primed, xd1, zd0), xs);
+		xf1 = lerpLanes(gradientLanes(seedX0, z1Primed, xd0, zd1), gradientLanes(seedX1, z1Primed, xd1, zd1), xs);
+	}
+	_mm_storeu_ps(out, _mm_mul_ps(lerpLanes(xf0, xf1, zs), _mm_set1_ps(PERLIN_SCALE)));
+}
+
+#endif
+
+} // namespace
+
+float PerlinNoise2D::get(int x, int z) const
+{
+	return sampleRow(m_seed, getRowTerms(x, m_frequency), z, m_frequency);
+}
+
+void PerlinNoise2D::generate(int originX, int originZ, int countX, int countZ, float* out) const
+{
+	for (int i = 0; i < countX; i++) {
+		RowTerms row = getRowTerms(originX + i, m_frequency);
+		float* rowOut = out + i * countZ;
+		int j = 0;
+#if defined(VOXL_AVX2) || defined(VOXL_SSE2)
+		for (; j + LANES <= countZ; j += LANES) {
+			sampleLanes(m_seed, row, originZ + j, m_frequency, rowOut + j);
+		}
+#endif
+		for (; j < countZ; j++) {
+			rowOut[j] = sampleRow(m_seed, row, originZ + j, m_frequency);
+		}
+	}
+}
+
+} // namespace voxl
@@ -1,6 +1,7 @@
 #include "glad/glad.h"
 #include "player.h"
 #include "chunk.h"
+#include "world_view.h"
 #include <iostream>
 
 namespace voxl {
@@ -120,7 +121,7 @@ void Player::processInput(GLFWwindow* window, float deltaTime) {
                     localBlockPos.x < Chunk::CHUNK_SIZE && localBlockPos.y < Chunk::CHUNK_HEIGHT && localBlockPos.z < Chunk::CHUNK_SIZE) {
                     chunk->setBlockType(localBlockPos.x, localBlockPos.y, localBlockPos.z, getSelectedBlock());
 
-                    m_chunkManager.updateChunk(chunk);
+                    m_chunkManager.markBlockDirty(chunk, localBlockPos);
                 }
             }
         }
@@ -141,7 +142,7 @@ void Player::processInput(GLFWwindow* window, float deltaTime) {
                     localBlockPos.x < Chunk::CHUNK_SIZE && localBlockPos.y < Chunk::CHUNK_HEIGHT && localBlockPos.z < Chunk::CHUNK_SIZE) {
                     chunk->setBlockType(localBlockPos.x, localBlockPos.y, localBlockPos.z, BlockType::None);
 
-                    m_chunkManager.updateChunk(chunk);
+                    m_chunkManager.markBlockDirty(chunk, localBlockPos);
                 }
             }
         }
@@ -175,6 +176,15 @@ void Player::processInput(GLFWwindow* window, float deltaTime) {
         }
         });
 
+    onPressedKey(GLFW_KEY_F3, [&]() {
+        if (m_chunkManager.getMeshingMode() == MeshingMode::Greedy) {
+            m_chunkManager.setMeshingMode(MeshingMode::Naive);
+        }
+        else {
+            m_chunkManager.setMeshingMode(MeshingMode::Greedy);
+        }
+        });
+
 
 	if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS) {
 		glfwSetWindowShouldClose(window, true);
@@ -187,7 +197,7 @@ void Player::processMouseMovement(double xpos, double ypos) {
 
 bool Player::rayCast(const ChunkManager& chunkManager, float maxDistance, glm::vec3& outBlockPosition, glm::vec3& outNormal) const
 {
-	std::unordered_set<BlockType> nonSelectableBlockTypes = { BlockType::Water, BlockType::None };
+    WorldView view(chunkManager);
     glm::vec3 rayOrigin = m_camera.getPosition();
     glm::vec3 rayDirection = glm::normalize(m_camera.getForward());
     float step = 0.1f;
@@ -196,23 +206,11 @@ bool Player::rayCast(const ChunkManager& chunkManager, float maxDistance, glm::v
     for (float distance = 0.0f; distance < maxDistance; distance += step) {
         currentPos = rayOrigin + rayDirection * distance;
 
-        // Check if the chunk exists
-        Chunk* chunk = chunkManager.getChunk(currentPos.x, currentPos.y, currentPos.z);
-        if (chunk == nullptr) {
-            continue;
-        }
-
-        // Get the local block position within the chunk
-		int blockX = glm::mod(glm::floor(currentPos.x), static_cast<float>(Chunk::CHUNK_SIZE));
-		int blockY = glm::mod(glm::floor(currentPos.y), static_cast<float>(Chunk::CHUNK_HEIGHT));
-		int blockZ = glm::mod(glm::floor(currentPos.z), static_cast<float>(Chunk::CHUNK_SIZE));
-
-		glm::ivec3 blockPos = glm::ivec3(blockX, blockY, blockZ);
-
-        // Check if there is a block at this position
-        if (nonSelectableBlockTypes.find(chunk->cubes[blockPos.x][blockPos.y][blockPos.z]) == nonSelectableBlockTypes.end()) {
+        // Water and air can't be selected, same as what the player collides with
+        glm::ivec3 blockPos = glm::ivec3(glm::floor(currentPos));
+        if (view.isSolid(blockPos.x, blockPos.y, blockPos.z)) {
             // Determine which face is hit based on ray direction
-            glm::vec3 blockCenter = chunk->getPosition() + glm::vec3(blockPos) + glm::vec3(0.5f);
+            glm::vec3 blockCenter = glm::vec3(blockPos) + glm::vec3(0.5f);
             glm::vec3 delta = currentPos - blockCenter;
 
             if (fabs(delta.x) > fabs(delta.y) && fabs(delta.x) > fabs(delta.z)) {
@@ -260,6 +258,12 @@ void Player::handleCollisions(float dx, float dy, float dz)
 	// normalize the direction
 	glm::vec3 direction = glm::normalize(glm::vec3(dx, dy, dz));
 
+	// All the probes below land in the chunks around the player, the view looks them up once
+	WorldView view(m_chunkManager);
+	auto isSolid = [&view](float x, float y, float z) {
+		return view.isSolid(static_cast<int>(std::floor(x)), static_cast<int>(std::floor(y)), static_cast<int>(std::floor(z)));
+	};
+
     float x1, y1, z1, x2, y2, z2, x3, y3, z3, x4, y4, z4, y5;
 	x1 = glm::floor(m_position.x - m_width);
 	y1 = glm::floor(m_position.y);
@@ -269,7 +273,7 @@ void Player::handleCollisions(float dx, float dy, float dz)
 	z2 = glm::floor(m_position.z + m_width);
 
     // Stuck check
-    while (m_chunkManager.isSolidBlock(floor(m_position.x), floor(m_position.y), floor(m_position.z))) {
+    while (isSolid(floor(m_position.x), floor(m_position.y), floor(m_position.z))) {
         m_position.y += 1.0f;
         y1 = floor(m_position.y - m_position.y);
         y2 = floor((m_position.y + (m_height + m_height + 2)));
@@ -279,8 +283,8 @@ void Player::handleCollisions(float dx, float dy, float dz)
     // Vertical collision
     // down
     if (direction.y != 0) {
-        if (m_chunkManager.isSolidBlock(x1, y1, z1) || m_chunkManager.isSolidBlock(x2, y1, z1) ||
-            m_chunkManager.isSolidBlock(x2, y1, z2) || m_chunkManager.isSolidBlock(x1, y1, z2)) {
+        if (isSolid(x1, y1, z1) || isSolid(x2, y1, z1) ||
+            isSolid(x2, y1, z2) || isSolid(x1, y1, z2)) {
             if (direction.y < 0) {
                 m_position.y = y1 + 1;
                 m_velocity.y = 0.0f;
@@ -293,8 +297,8 @@ void Player::handleCollisions(float dx, float dy, float dz)
     }
 
     // up
-	if (m_chunkManager.isSolidBlock(x1, y2, z1) || m_chunkManager.isSolidBlock(x2, y2, z1) ||
-		m_chunkManager.isSolidBlock(x2, y2, z2) || m_chunkManager.isSolidBlock(x1, y2, z2)) {
+	if (isSolid(x1, y2, z1) || isSolid(x2, y2, z1) ||
+		isSolid(x2, y2, z2) || isSolid(x1, y2, z2)) {
 		if (direction.y > 0) {
 			m_position.y = y2 - m_height - 0.01f;
 			m_velocity.y = 0.0f;
@@ -311,9 +315,9 @@ void Player::handleCollisions(float dx, float dy, float dz)
 	y5 = glm::round(y3 + (y4 - y3) / 2); // previous y position
 	
 	// right
-	if (m_chunkManager.isSolidBlock(x1, y3, z3) || m_chunkManager.isSolidBlock(x1, y3, z4) ||
-		m_chunkManager.isSolidBlock(x1, y4, z3) || m_chunkManager.isSolidBlock(x1, y4, z4) ||
-        m_chunkManager.isSolidBlock(x1, y5, z3) || m_chunkManager.isSolidBlock(x1, y5, z4)) {
+	if (isSolid(x1, y3, z3) || isSolid(x1, y3, z4) ||
+		isSolid(x1, y4, z3) || isSolid(x1, y4, z4) ||
+        isSolid(x1, y5, z3) || isSolid(x1, y5, z4)) {
 		
         if (direction.x < 0) {
             m_position.x = x3 + m_width;
@@ -322,9 +326,9 @@ void Player::handleCollisions(float dx, float dy, float dz)
 	}
 
 	// left
-    if (m_chunkManager.isSolidBlock(x2, y3, z3) || m_chunkManager.isSolidBlock(x2, y3, z4) ||
-        m_chunkManager.isSolidBlock(x2, y4, z3) || m_chunkManager.isSolidBlock(x2, y4, z4) ||
-        m_chunkManager.isSolidBlock(x2, y5, z3) || m_chunkManager.isSolidBlock(x2, y5, z4)) {
+    if (isSolid(x2, y3, z3) || isSolid(x2, y3, z4) ||
+        isSolid(x2, y4, z3) || isSolid(x2, y4, z4) ||
+        isSolid(x2, y5, z3) || isSolid(x2, y5, z4)) {
 
         if (direction.x > 0) {
             m_position.x = (x4+1) - m_width - 0.01f;
@@ -333,9 +337,9 @@ void Player::handleCollisions(float dx, float dy, float dz)
     }
 
 	// forward
-    if (m_chunkManager.isSolidBlock(x3, y3, z1) || m_chunkManager.isSolidBlock(x4, y3, z1) ||
-        m_chunkManager.isSolidBlock(x4, y4, z1) || m_chunkManager.isSolidBlock(x3, y4, z1) ||
-        m_chunkManager.isSolidBlock(x3, y5, z1) || m_chunkManager.isSolidBlock(x4, y5, z1)) {
+    if (isSolid(x3, y3, z1) || isSolid(x4, y3, z1) ||
+        isSolid(x4, y4, z1) || isSolid(x3, y4, z1) ||
+        isSolid(x3, y5, z1) || isSolid(x4, y5, z1)) {
 
         if (direction.z < 0) {
             m_position.z = z3 + m_width;
@@ -344,9 +348,9 @@ void Player::handleCollisions(float dx, float dy, float dz)
     }
 
 	// backward
-    if (m_chunkManager.isSolidBlock(x3, y3, z2) || m_chunkManager.isSolidBlock(x4, y3, z2) ||
-        m_chunkManager.isSolidBlock(x4, y4, z2) || m_chunkManager.isSolidBlock(x3, y4, z2) ||
-        m_chunkManager.isSolidBlock(x3, y5, z2) || m_chunkManager.isSolidBlock(x4, y5, z2)) {
+    if (isSolid(x3, y3, z2) || isSolid(x4, y3, z2) ||
+        isSolid(x4, y4, z2) || isSolid(x3, y4, z2) ||
+        isSolid(x3, y5, z2) || isSolid(x4, y5, z2)) {
 
         if (direction.z > 0) {
             m_position.z = (z4+1) - m_width - 0.01f;
@@ -0,0 +1,256 @@
+#include "region_file.h"
+#include "chunk.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+namespace voxl {
+
+namespace {
+
+const char MAGIC[4] = { 'V', 'X', 'L', 'R' };
+const uint32_t HEADER_SIZE = 16;
+const uint32_t TABLE_SIZE = RegionFile::REGION_SIZE * RegionFile::REGION_SIZE * 8;
+
+void appendU16(std::vector<uint8_t>& out, uint32_t value)
+{
+	out.push_back(static_cast<uint8_t>(value));
+	out.push_back(static_cast<uint8_t>(value >> 8));
+}
+
+void writeU32(uint8_t* out, uint32_t value)
+{
+	for (int i = 0; i < 4; i++) {
+		out[i] = static_cast<uint8_t>(value >> (i * 8));
+	}
+}
+
+uint32_t readU32(const uint8_t* in)
+{
+	return in[0] | (in[1] << 8) | (in[2] << 16) | (static_cast<uint32_t>(in[3]) << 24);
+}
+
+} // namespace
+
+RegionFile::RegionFile(const std::filesystem::path& path)
+	: m_table(REGION_SIZE * REGION_SIZE)
+{
+	if (!std::filesystem::exists(path)) {
+		std::ofstream create(path, std::ios::binary);
+	}
+	m_file.open(path, std::ios::in | std::ios::out | std::ios::binary);
+	if (!m_file.is_open()) {
+		std::cerr << "Failed to open region file " << path << std::endl;
+		return;
+	}
+
+	m_sectorCount = getSectorSpan(HEADER_SIZE + TABLE_SIZE);
+
+	std::vector<uint8_t> header(HEADER_SIZE + TABLE_SIZE);
+	m_file.read(reinterpret_cast<char*>(header.data()), header.size());
+	if (m_file.gcount() == 0) {
+		// New file
+		m_file.clear();
+		writeHeader();
+		return;
+	}
+
+	if (m_file.gcount() != static_cast<std::streamsize>(header.size()) || std::memcmp(header.data(), MAGIC, 4) != 0 ||
+		readU32(&header[4]) != VERSION || readU32(&header[8]) != REGION_SIZE) {
+		std::cerr << "Ignoring region file " << path << " with an unknown format" << std::endl;
+		m_file.close();
+		return;
+	}
+
+	for (size_t i = 0; i < m_table.size(); i++) {
+		const uint8_t* entry = &header[HEADER_SIZE + i * 8];
+		m_table[i].sector = readU32(entry);
+		m_table[i].size = readU32(entry + 4);
+		if (m_table[i].size > 0) {
+			m_sectorCount = std::max(m_sectorCount, m_table[i].sector + getSectorSpan(m_table[i].size));
+		}
+	}
+}
+
+RegionFile::~RegionFile()
+{
+	if (m_file.is_open()) {
+		m_file.flush();
+	}
+}
+
+bool RegionFile::hasChunk(const glm::ivec3& chunkPos) const
+{
+	return m_table[getTableIndex(chunkPos)].size > 0;
+}
+
+uint32_t RegionFile::getChunkSize(const glm::ivec3& chunkPos) const
+{
+	return m_table[getTableIndex(chunkPos)].size;
+}
+
+bool RegionFile::readChunk(const glm::ivec3& chunkPos, Chunk& chunk)
+{
+	const TableEntry& entry = m_table[getTableIndex(chunkPos)];
+	if (!m_file.is_open() || entry.size == 0) {
+		return false;
+	}
+
+	std::vector<uint8_t> data(entry.size);
+	m_file.clear();
+	m_file.seekg(static_cast<std::streamoff>(entry.sector) * SECTOR_SIZE);
+	m_file.read(reinterpret_cast<char*>(data.data()), data.size());
+	if (m_file.gcount() != static_cast<std::streamsize>(data.size())) {
+		m_file.clear();
+		return false;
+	}
+
+	return decodeChunk(data, chunk);
+}
+
+bool RegionFile::writeChunk(const glm::ivec3& chunkPos, const Chunk& chunk)
+{
+	if (!m_file.is_open()) {
+		return false;
+	}
+
+	std::vector<uint8_t> data;
+	encodeChunk(chunk, data);
+
+	int index = getTableIndex(chunkPos);
+	TableEntry& entry = m_table[index];
+	uint32_t size = static_cast<uint32_t>(data.size());
+	uint32_t span = getSectorSpan(size);
+
+	// Reuse the old sectors when the chunk still fits, otherwise append
+	uint32_t sector = entry.sector;
+	if (entry.size == 0 || getSectorSpan(entry.size) < span) {
+		sector = m_sectorCount;
+		m_sectorCount += span;
+	}
+
+	// Pad to whole sectors so the next append starts at the end of the file
+	data.resize(span * SECTOR_SIZE, 0);
+
+	m_file.clear();
+	m_file.seekp(static_cast<std::streamoff>(sector) * SECTOR_SIZE);
+	m_file.write(reinterpret_cast<const char*>(data.data()), data.size());
+
+	entry.sector = sector;
+	entry.size = size;
+	return writeTableEntry(index) && m_file.good();
+}
+
+glm::ivec3 RegionFile::getRegionPos(const glm::ivec3& chunkPos)
+{
+	return glm::ivec3(
+		static_cast<int>(std::floor(chunkPos.x / static_cast<float>(REGION_SIZE))), 0,
+		static_cast<int>(std::floor(chunkPos.z / static_cast<float>(REGION_SIZE))));
+}
+
+std::string RegionFile::getFileName(const glm::ivec3& regionPos)
+{
+	return "r." + std::to_string(regionPos.x) + "." + std::to_string(regionPos.z) + ".vxr";
+}
+
+int RegionFile::getTableIndex(const glm::ivec3& chunkPos)
+{
+	int x = ((chunkPos.x % REGION_SIZE) + REGION_SIZE) % REGION_SIZE;
+	int z = ((chunkPos.z % REGION_SIZE) + REGION_SIZE) % REGION_SIZE;
+	return z * REGION_SIZE + x;
+}
+
+bool RegionFile::writeHeader()
+{
+	std::vector<uint8_t> header(HEADER_SIZE + TABLE_SIZE, 0);
+	std::memcpy(header.data(), MAGIC, 4);
+	writeU32(&header[4], VERSION);
+	writeU32(&header[8], REGION_SIZE);
+
+	m_file.seekp(0);
+	m_file.write(reinterpret_cast<const char*>(header.data()), header.size());
+	m_file.flush();
+	return m_file.good();
+}
+
+bool RegionFile::writeTableEntry(int index)
+{
+	uint8_t entry[8];
+	writeU32(entry, m_table[index].sector);
+	writeU32(entry + 4, m_table[index].size);
+
+	m_file.seekp(HEADER_SIZE + index * 8);
+	m_file.write(reinterpret_cast<const char*>(entry), sizeof(entry));
+	m_file.flush();
+	return m_file.good();
+}
+
+void RegionFile::encodeChunk(const Chunk& chunk, std::vector<uint8_t>& out)
+{
+	std::vector<BlockType> blocks(ChunkSection::VOLUME);
+
+	out.push_back(static_cast<uint8_t>(Chunk::SECTION_COUNT));
+	for (int i = 0; i < Chunk::SECTION_COUNT; i++) {
+		const ChunkSection& section = chunk.getSection(i);
+
+		// Runs of (block id, length) over the section in index order, a uniform section is a single run
+		if (section.isUniform()) {
+			out.push_back(static_cast<uint8_t>(section.getUniformType()));
+			appendU16(out, ChunkSection::VOLUME);
+			continue;
+		}
+
+		section.store(blocks.data());
+		int start = 0;
+		while (start < ChunkSection::VOLUME) {
+			int end = start + 1;
+			while (end < ChunkSection::VOLUME && blocks[end] == blocks[start]) {
+				end++;
+			}
+			out.push_back(static_cast<uint8_t>(blocks[start]));
+			appendU16(out, end - start);
+			start = end;
+		}
+	}
+}
+
+bool RegionFile::decodeChunk(const std::vector<uint8_t>& data, Chunk& chunk)
+{
+	if (data.empty() || data[0] != Chunk::SECTION_COUNT) {
+		return false;
+	}
+
+	// Decoded aside so a corrupt record leaves the chunk untouched
+	std::array<ChunkSection, Chunk::SECTION_COUNT> sections;
+	std::vector<BlockType> blocks(ChunkSection::VOLUME);
+	size_t offset = 1;
+	for (int i = 0; i < Chunk::SECTION_COUNT; i++) {
+		int filled = 0;
+		while (filled < ChunkSection::VOLUME) {
+			if (offset + 3 > data.size()) {
+				return false;
+			}
+			BlockType type = static_cast<BlockType>(data[offset]);
+			int length = data[offset + 1] | (data[offset + 2] << 8);
+			offset += 3;
+			if (length == 0 || filled + length > ChunkSection::VOLUME) {
+				return false;
+			}
+			std::fill_n(blocks.begin() + filled, length, type);
+			filled += length;
+		}
+
+		sections[i].load(blocks.data());
+	}
+
+	for (int i = 0; i < Chunk::SECTION_COUNT; i++) {
+		chunk.getSection(i) = std::move(sections[i]);
+	}
+	chunk.setModified(false);
+	return true;
+}
+
+} // namespace voxl
@@ -77,6 +77,15 @@ void Renderer::init()
 	m_defaultShader->SetUniform1f("fogEnd", ChunkManager::LOAD_RADIUS * Chunk::CHUNK_SIZE);
 	m_defaultShader->SetUniform3f("fogColor", m_skyColor.x, m_skyColor.y, m_skyColor.z);*/
 
+	// Block color palette, indexed by the block id packed in chunk vertices
+	for (const auto& [type, color] : g_cubeColors) {
+		float alpha = (type == BlockType::Water) ? 0.5f : 1.0f;
+		m_defaultShader->SetUniform4f("blockColors[" + std::to_string(static_cast<int>(type)) + "]", color.r, color.g, color.b, alpha);
+	}
+
+	m_defaultShader->SetUniform1i("shadowMap", 1);
+	m_defaultShader->SetUniform1i("occlusionMap", 2);
+
 	initLighting();
 	initDepthMap();
 
@@ -102,7 +111,7 @@ void Renderer::initUI() const
 	ImGui_ImplOpenGL3_Init();
 }
 
-void Renderer::setupUI(Player& player, const glm::vec3& blockPos = glm::vec3(-10000.0f))
+void Renderer::setupUI(Player& player, const ChunkManager& chunkManager, const glm::vec3& blockPos = glm::vec3(-10000.0f))
 {
 	ImGui_ImplOpenGL3_NewFrame();
 	ImGui_ImplGlfw_NewFrame();
@@ -112,7 +121,7 @@ void Renderer::setupUI(Player& player, const glm::vec3& blockPos = glm::vec3(-10
 
 	// Information Panel
 	ImGui::SetNextWindowPos(ImVec2(10, 10), ImGuiCond_Always);
-	ImGui::SetNextWindowSize(ImVec2(300, 100), ImGuiCond_Always);
+	ImGui::SetNextWindowSize(ImVec2(300, 0), ImGuiCond_Always);
 
 	ImGui::Begin("Info", nullptr, ImGuiWindowFlags_NoMove | ImGuiWindowFlags_NoResize | ImGuiWindowFlags_NoCollapse | ImGuiWindowFlags_NoTitleBar);
 	ImGui::Text("App average %.3f ms/frame (%.1f FPS)\n", 1000.0f / ImGui::GetIO().Framerate, ImGui::GetIO().Framerate);
@@ -124,6 +133,38 @@ void Renderer::setupUI(Player& player, const glm::vec3& blockPos = glm::vec3(-10
 	/*ImGui::Text("Light Azimuth: %.2f", m_lightAzimuth);
 	ImGui::Text("Light Elevation: %.2f", m_lightElevation);*/
 	ImGui::Text("Light Direction: (%.2f, %.2f, %.2f)", m_lightDir.x, m_lightDir.y, m_lightDir.z);
+	ImGui::Text("Shadows: %d x %d^2, %.2f MiB, to %.0f", m_shadowSettings.cascadeCount, m_shadowSettings.resolution,
+		getShadowMapBytes() / (1024.0f * 1024.0f), m_shadowSettings.distance);
+
+	ChunkMemoryStats memoryStats = chunkManager.getMemoryStats();
+	ImGui::Text("");
+	ImGui::Text("Chunks: %zu (%zu/%zu uniform sections)", memoryStats.chunkCount, memoryStats.uniformSectionCount, memoryStats.sectionCount);
+	ImGui::Text("Voxel memory: %.2f MiB (dense %.2f MiB)", memoryStats.voxelBytes / (1024.0f * 1024.0f), memoryStats.denseBytes / (1024.0f * 1024.0f));
+	ImGui::Text("Light memory: %.2f MiB", memoryStats.lightBytes / (1024.0f * 1024.0f));
+	ChunkStorageStats storageStats = chunkManager.getStorageStats();
+	ImGui::Text("Chunks loaded: %zu, generated: %zu", storageStats.loadedCount, storageStats.generatedCount);
+	ChunkStageStats stageStats = chunkManager.getStageStats();
+	for (int stage = static_cast<int>(ChunkStage::Terrain); stage < CHUNK_STAGE_COUNT; stage++) {
+		ImGui::Text("  %-9s %4zu chunks, %6zu runs, %8.1f ms", getStageName(static_cast<ChunkStage>(stage)), stageStats.chunkCount[stage],
+			stageStats.completedCount[stage], stageStats.totalMs[stage]);
+	}
+	ImGui::Text("  generating: %zu, pending decoration blocks: %zu", stageStats.generatingCount, stageStats.pendingWriteCount);
+	ChunkCacheStats cacheStats = chunkManager.getCacheStats();
+	ImGui::Text("Cache: %.1f/%.1f MiB, %zu out of view", cacheStats.usedBytes / (1024.0f * 1024.0f), cacheStats.budgetBytes / (1024.0f * 1024.0f), cacheStats.cachedChunkCount);
+	ImGui::Text("Cache hits: %zu, misses: %zu", cacheStats.hits, cacheStats.misses);
+	ImGui::Text("Evictions: %zu meshes, %zu chunks", cacheStats.meshEvictions, cacheStats.chunkEvictions);
+	TerrainCacheStats terrainStats = chunkManager.getTerrain().getStats();
+	ImGui::Text("Terrain tiles: %zu/%zu, hits: %zu, misses: %zu", terrainStats.tileCount, terrainStats.tileLimit, terrainStats.hits, terrainStats.misses);
+
+	ChunkMeshStats meshStats = chunkManager.getMeshStats();
+	ImGui::Text("Meshing (F3): %s", chunkManager.getMeshingMode() == MeshingMode::Greedy ? "greedy" : "naive");
+	ImGui::Text("Quads: %zu (naive %zu)", meshStats.quadCount, meshStats.faceCount);
+	ImGui::Text("Pending: %zu chunk loads, %zu section meshes", chunkManager.getPendingLoadCount(), chunkManager.getPendingMeshCount());
+	ChunkEditStats editStats = chunkManager.getEditStats();
+	ImGui::Text("Last edit: %zu sections, %.2f ms (%zu edits, %zu sections)", editStats.lastEditSectionCount, editStats.lastEditMeshMs,
+		editStats.editCount, editStats.remeshedSectionCount);
+	ImGui::Text("Last edit light: %.3f ms", editStats.lastEditLightMs);
+	ImGui::Text("Sections meshed: %zu, skipped: %zu", meshStats.meshedSectionCount, meshStats.skippedSectionCount);
 	ImGui::End();
 
 	// Crosshair
@@ -134,8 +175,8 @@ void Renderer::setupUI(Player& player, const glm::vec3& blockPos = glm::vec3(-10
 	ImGui::End();
 
 	// Inventory Bar
-	ImGui::SetNextWindowPos(ImVec2(window_width / 2.0f - 150, window_height - 80), ImGuiCond_Always);
-	ImGui::SetNextWindowSize(ImVec2(300, 70), ImGuiCond_Always);
+	ImGui::SetNextWindowPos(ImVec2(window_width / 2.0f - 180, window_height - 80), ImGuiCond_Always);
+	ImGui::SetNextWindowSize(ImVec2(360, 70), ImGuiCond_Always);
 
 	ImGui::Begin("Inventory", nullptr, ImGuiWindowFlags_NoTitleBar | ImGuiWindowFlags_NoResize | ImGuiWindowFlags_NoMove | ImGuiWindowFlags_NoScrollbar | ImGuiWindowFlags_NoSavedSettings);
 
@@ -179,6 +220,7 @@ void Renderer::setupUI(Player& player, const glm::vec3& blockPos = glm::vec3(-10
 void Renderer::update(Player& player, const ChunkManager& chunkManager)
 {
 	bool blockFound = player.blockFound();
+	updateCascades(player.getCamera());
 	renderShadowMap(chunkManager);
 
 	glClearColor(m_skyColor.r, m_skyColor.g, m_skyColor.b, m_skyColor.a);
@@ -191,7 +233,7 @@ void Renderer::update(Player& player, const ChunkManager& chunkManager)
 
 	if (blockFound) {
 		glm::vec3 blockPosition = player.getBlockPosition();
-		setupUI(player, blockPosition);
+		setupUI(player, chunkManager, blockPosition);
 
 		glDisable(GL_CULL_FACE);
 		glStencilOp(GL_KEEP, GL_KEEP, GL_REPLACE);
@@ -221,7 +263,7 @@ void Renderer::update(Player& player, const ChunkManager& chunkManager)
 		glCullFace(GL_BACK);
 	}
 	else {
-		setupUI(player);
+		setupUI(player, chunkManager);
 	}
 
 	renderUI();
@@ -235,39 +277,62 @@ void Renderer::renderCube(BlockType type, glm::vec3 position, glm::mat4 view, gl
 {
 	glm::mat4 scaledModel = glm::scale(glm::translate(glm::mat4(1.0f), position), glm::vec3(1.01f, 1.01f, 1.01f));
 	
-	renderMesh(*m_cubeMesh, *m_defaultShader, scaledModel, view, projection);
+	// Only used to fill the stencil buffer, the cube mesh is not in the packed chunk format
+	renderMesh(*m_cubeMesh, *m_highlightShader, scaledModel, view, projection);
 }
 
 
-void Renderer::renderChunk(Chunk& chunk, glm::mat4 view, glm::mat4 projection, bool transparent)
-{	
-	glActiveTexture(GL_TEXTURE1);
-	glBindTexture(GL_TEXTURE_2D, m_depthMap);
-	m_defaultShader->Bind();
-	if (transparent) {
-		if (chunk.getWaterMesh()) {
-			m_defaultShader->SetUniformBool("useShadows", false);
-			renderMesh(*chunk.getWaterMesh(), *m_defaultShader, glm::translate(glm::mat4(1.0), chunk.getPosition()), view, projection);
+void Renderer::renderChunk(const RenderEntry& entry, bool transparent)
+{
+	m_defaultShader->SetUniformMat4f("model", glm::translate(glm::mat4(1.0), entry.origin));
+
+	// Sections that were empty or fully enclosed have nothing to draw
+	const auto& draws = transparent ? entry.water : entry.opaque;
+	for (int section = 0; section < Chunk::SECTION_COUNT; section++) {
+		const SectionDraw& draw = draws[section];
+		if (draw.indexCount > 0) {
+			glBindTexture(GL_TEXTURE_2D, draw.occlusionMap);
+			m_defaultShader->SetUniform1i("sectionBaseY", section * ChunkSection::SIZE);
+			glBindVertexArray(draw.vao);
+			glDrawElements(GL_TRIANGLES, draw.indexCount, GL_UNSIGNED_INT, nullptr);
 		}
 	}
-	else {
-		m_defaultShader->SetUniformBool("useShadows", true);
-		renderMesh(*chunk.getMesh(), *m_defaultShader, glm::translate(glm::mat4(1.0), chunk.getPosition()), view, projection);
-	}
 }
 
 void Renderer::renderChunks(const ChunkManager& chunkManager, glm::mat4 view, glm::mat4 projection)
 {
-	for (auto& chunk : chunkManager.getChunks()) {
-		renderChunk(*chunk.second, view, projection, false); // Render opaque
+	std::span<const RenderEntry> renderList = chunkManager.getRenderList();
+
+	glActiveTexture(GL_TEXTURE1);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, m_depthMap);
+	glActiveTexture(GL_TEXTURE2); // Occlusion maps, bound per section in renderChunk
+	m_defaultShader->Bind();
+	m_defaultShader->SetUniformMat4f("view", view);
+	m_defaultShader->SetUniformMat4f("projection", projection);
+
+	m_defaultShader->SetUniform1i("cascadeCount", m_shadowSettings.cascadeCount);
+	for (int i = 0; i < m_shadowSettings.cascadeCount; i++) {
+		const std::string index = "[" + std::to_string(i) + "]";
+		m_defaultShader->SetUniformMat4f("lightSpaceMatrices" + index, m_cascades[i].lightSpaceMatrix);
+		m_defaultShader->SetUniform1f("cascadeSplits" + index, m_cascades[i].splitDistance);
+		m_defaultShader->SetUniform1f("cascadeTexelSizes" + index, m_cascades[i].texelSize);
+	}
+
+	m_defaultShader->SetUniformBool("useShadows", true);
+	for (const RenderEntry& entry : renderList) {
+		renderChunk(entry, false); // Render opaque
 	}
 
 	// Render transparent objects
 	glDepthMask(GL_FALSE); 
-	for (auto& chunk : chunkManager.getChunks()) {
-		renderChunk(*chunk.second, view, projection, true); // Render transparent
+	m_defaultShader->SetUniformBool("useShadows", false);
+	for (const RenderEntry& entry : renderList) {
+		renderChunk(entry, true); // Render transparent
 	}
 	glDepthMask(GL_TRUE); 
+
+	glBindVertexArray(0);
+	glActiveTexture(GL_TEXTURE0);
 }
 
 void Renderer::renderHighlight(glm::vec3 block, glm::mat4 view, glm::mat4 projection)
@@ -290,10 +355,9 @@ void Renderer::renderMesh(Mesh& mesh, Shader& shader, glm::mat4 model, glm::mat4
 	shader.SetUniformMat4f("model", model);
 	shader.SetUniformMat4f("view", view);
 	shader.SetUniformMat4f("projection", projection);
-	if (shader.GetID() == m_defaultShader->GetID()) shader.SetUniformMat4f("lightSpaceMatrix", m_lightSpaceMatrix);
 
 
-	glDrawElements(GL_TRIANGLES, mesh.indices.size(), GL_UNSIGNED_INT, nullptr); 
+	glDrawElements(GL_TRIANGLES, mesh.indexCount, GL_UNSIGNED_INT, nullptr); 
 
 	glBindVertexArray(0);
 }
@@ -321,25 +385,114 @@ void Renderer::clear()
 
 void Renderer::initDepthMap()
 {
-	glGenFramebuffers(1, &m_depthMapFBO);
+	if (m_depthMapFBO == 0) {
+		glGenFramebuffers(1, &m_depthMapFBO);
+	}
+	if (m_depthMap != 0) {
+		glDeleteTextures(1, &m_depthMap);
+	}
 
 	glGenTextures(1, &m_depthMap);
-	glBindTexture(GL_TEXTURE_2D, m_depthMap);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT32F, SHADOW_WIDTH, SHADOW_HEIGHT, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, m_depthMap);
+	glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, m_shadowSettings.depthFormat, m_shadowSettings.resolution, m_shadowSettings.resolution,
+		m_shadowSettings.cascadeCount, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+	// Sampled with depth comparison, linear filtering makes each lookup a 2x2 PCF in hardware
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
 	float borderColor[] = { 1.0, 1.0, 1.0, 1.0 };
-	glTexParameterfv(GL_TEXTURE_2D, GL_TEXTURE_BORDER_COLOR, borderColor);
+	glTexParameterfv(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BORDER_COLOR, borderColor);
 
 	glBindFramebuffer(GL_FRAMEBUFFER, m_depthMapFBO);
-	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, m_depthMap, 0);
+	glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, m_depthMap, 0, 0);
 	glDrawBuffer(GL_NONE);
 	glReadBuffer(GL_NONE);
 	glBindFramebuffer(GL_FRAMEBUFFER, 0);
 }
 
+void Renderer::setShadowSettings(const ShadowSettings& settings)
+{
+	m_shadowSettings = settings;
+	m_shadowSettings.cascadeCount = std::clamp(settings.cascadeCount, 1, MAX_SHADOW_CASCADES);
+	initDepthMap();
+}
+
+size_t Renderer::getShadowMapBytes() const
+{
+	// Drivers store 24 bit depth in 32 bits
+	size_t texelBytes = m_shadowSettings.depthFormat == GL_DEPTH_COMPONENT16 ? 2 : 4;
+	size_t layerTexels = static_cast<size_t>(m_shadowSettings.resolution) * m_shadowSettings.resolution;
+	return layerTexels * m_shadowSettings.cascadeCount * texelBytes;
+}
+
+void Renderer::updateCascades(const Camera& camera)
+{
+	const ShadowSettings& settings = m_shadowSettings;
+	float nearPlane = camera.getNearClippingPlane();
+	float tanHalfFov = tan(camera.getFov() * 0.5f);
+	// Squared distance from the view axis to a frustum corner, per unit of view depth squared
+	float cornerSpread = tanHalfFov * tanHalfFov * (1.0f + camera.getAspectRatio() * camera.getAspectRatio());
+
+	glm::mat4 lightView = glm::lookAt(glm::vec3(0.0f), -m_lightDir, glm::vec3(0.0f, 1.0f, 0.0f));
+
+	float sliceNear = nearPlane;
+	for (int i = 0; i < settings.cascadeCount; i++) {
+		ShadowCascade& cascade = m_cascades[i];
+
+		float t = static_cast<float>(i + 1) / settings.cascadeCount;
+		float logSplit = nearPlane * pow(settings.distance / nearPlane, t);
+		float evenSplit = nearPlane + (settings.distance - nearPlane) * t;
+		float sliceFar = settings.splitLambda * logSplit + (1.0f - settings.splitLambda) * evenSplit;
+
+		// Smallest sphere around the slice. It only depends on the slice, so the cascade keeps its
+		// size as the camera turns and its texels keep their world size.
+		float centerDepth = std::min((sliceNear + sliceFar) * (1.0f + cornerSpread) * 0.5f, sliceFar);
+		float radius = sqrt((sliceFar - centerDepth) * (sliceFar - centerDepth) + sliceFar * sliceFar * cornerSpread);
+		glm::vec3 center = camera.getPosition() + camera.getForward() * centerDepth;
+
+		// Snap the center to whole texels across the light direction
+		float texelSize = 2.0f * radius / settings.resolution;
+		glm::vec3 lightCenter = glm::vec3(lightView * glm::vec4(center, 1.0f));
+		lightCenter.x = floor(lightCenter.x / texelSize) * texelSize;
+		lightCenter.y = floor(lightCenter.y / texelSize) * texelSize;
+
+		// The light looks down -z, casters toward it have a higher z
+		cascade.boundsMin = lightCenter - glm::vec3(radius);
+		cascade.boundsMax = lightCenter + glm::vec3(radius, radius, radius + SHADOW_CASTER_MARGIN);
+		glm::mat4 lightProjection = glm::ortho(cascade.boundsMin.x, cascade.boundsMax.x, cascade.boundsMin.y, cascade.boundsMax.y,
+			-cascade.boundsMax.z, -cascade.boundsMin.z);
+
+		cascade.lightView = lightView;
+		cascade.lightSpaceMatrix = lightProjection * lightView;
+		cascade.splitDistance = sliceFar;
+		cascade.texelSize = texelSize;
+		sliceNear = sliceFar;
+	}
+}
+
+bool Renderer::isInCascade(const RenderEntry& entry, const ShadowCascade& cascade)
+{
+	// Box around the chunk in light view space
+	glm::vec3 center = glm::vec3(cascade.lightView * glm::vec4((entry.boundsMin + entry.boundsMax) * 0.5f, 1.0f));
+	glm::vec3 halfSize = (entry.boundsMax - entry.boundsMin) * 0.5f;
+	glm::vec3 extent(0.0f);
+	for (int axis = 0; axis < 3; axis++) {
+		for (int i = 0; i < 3; i++) {
+			extent[axis] += std::abs(cascade.lightView[i][axis]) * halfSize[i];
+		}
+	}
+
+	for (int axis = 0; axis < 3; axis++) {
+		if (center[axis] + extent[axis] < cascade.boundsMin[axis] || center[axis] - extent[axis] > cascade.boundsMax[axis]) {
+			return false;
+		}
+	}
+	return true;
+}
+
 void Renderer::initLighting()
 {
 	// Day/Night cycle parameters initialization
@@ -349,11 +502,6 @@ void Renderer::initLighting()
 	m_eastAzimuth = 0.0f; 
 	m_westAzimuth = 2 * glm::pi<float>();
 
-	float near_plane = 0.1f, far_plane = 300.0f;
-	float shadowRadius = 100.0f;
-
-	m_lightProjection = glm::ortho(-shadowRadius, shadowRadius, -shadowRadius, shadowRadius, near_plane, far_plane);
-
 	// Define azimuth and elevation angles
 	m_lightAzimuth = glm::pi<float>();
 	m_lightElevation = -1.5f;
@@ -363,12 +511,6 @@ void Renderer::initLighting()
 	m_lightDir.y = sin(m_lightElevation);
 	m_lightDir.z = cos(m_lightElevation) * sin(m_lightAzimuth);
 
-	glm::vec3 lightTarget = glm::vec3(0.0f, 0.0f, 0.0f);
-	m_lightPos = lightTarget + m_lightDir * m_lightDistance;
-
-	m_lightView = glm::lookAt(m_lightPos, lightTarget, glm::vec3(0.0f, 1.0f, 0.0f));
-	m_lightSpaceMatrix = m_lightProjection * m_lightView;
-
 	m_defaultShader->Bind();
 	m_defaultShader->SetUniform3f("lightDir", m_lightDir.x, m_lightDir.y, m_lightDir.z);
 }
@@ -424,18 +566,7 @@ void Renderer::updateLighting(const glm::vec3& playerPosition, float deltaTime)
 	else {
 		m_defaultShader->SetUniformBool("isDay", false);
 	}
-
-	// Update light position (relative to the player)
-	glm::vec3 lightTarget = playerPosition;
-	m_lightPos = playerPosition + m_lightDir * m_lightDistance;
-
-	// Update shadow matrices
-	m_lightView = glm::lookAt(m_lightPos, lightTarget, glm::vec3(0.0f, 1.0f, 0.0f));
-	m_lightSpaceMatrix = m_lightProjection * m_lightView;
-
-	// Pass updated matrices to the shadow shader
-	m_shadowShader->Bind();
-	m_shadowShader->SetUniformMat4f("lightSpaceMatrix", m_lightSpaceMatrix);
+	// Shadow matrices follow the camera, see updateCascades
 }
 
 
@@ -471,27 +602,37 @@ unsigned int Renderer::loadTexture(const char* path)
 
 void Renderer::renderShadowMap(const ChunkManager& chunkManager)
 {
-	glViewport(0, 0, SHADOW_WIDTH, SHADOW_HEIGHT);
+	glViewport(0, 0, m_shadowSettings.resolution, m_shadowSettings.resolution);
 	glBindFramebuffer(GL_FRAMEBUFFER, m_depthMapFBO); 
-	glClear(GL_DEPTH_BUFFER_BIT); 
 
 	// Front face culling to fix peter panning
 	glCullFace(GL_FRONT);
 
 	m_shadowShader.get()->Bind();
 
-	// Render chunks to shadow map (TODO: optimization, only render chunk if it is within the shadow radius)
-	for (auto& chunk : chunkManager.getChunks()) {
-		Mesh& mesh = *chunk.second->getMesh();
-		glBindVertexArray(mesh.VAO);
+	for (int i = 0; i < m_shadowSettings.cascadeCount; i++) {
+		const ShadowCascade& cascade = m_cascades[i];
+		glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, m_depthMap, 0, i);
+		glClear(GL_DEPTH_BUFFER_BIT);
+		m_shadowShader.get()->SetUniformMat4f("lightSpaceMatrix", cascade.lightSpaceMatrix);
 
-		// Set uniforms
-		m_shadowShader.get()->SetUniformMat4f("model", glm::translate(glm::mat4(1.0), chunk.second->getPosition()));
-
-		glDrawElements(GL_TRIANGLES, mesh.indices.size(), GL_UNSIGNED_INT, nullptr);
-
-		glBindVertexArray(0);
+		// Only chunks that can cast into the cascade
+		for (const RenderEntry& entry : chunkManager.getRenderList()) {
+			if (!isInCascade(entry, cascade)) {
+				continue;
+			}
+			m_shadowShader.get()->SetUniformMat4f("model", glm::translate(glm::mat4(1.0), entry.origin));
+
+			for (const SectionDraw& draw : entry.opaque) {
+				// Meshes are built in the background, a new section may not have one yet
+				if (draw.indexCount > 0) {
+					glBindVertexArray(draw.vao);
+					glDrawElements(GL_TRIANGLES, draw.indexCount, GL_UNSIGNED_INT, nullptr);
+				}
+			}
+		}
 	}
+	glBindVertexArray(0);
 
 	glBindFramebuffer(GL_FRAMEBUFFER, 0); 
 	glViewport(0, 0, window_width, window_height);
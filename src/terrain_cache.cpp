@@ -0,0 +1,225 @@
+#include "terrain_cache.h"
+
+#define FNL_IMPL
+#include "FastNoiseLite.h"
+
+#include <algorithm>
+
+namespace voxl {
+
+namespace {
+
+struct BiomeNoiseConfig {
+	uint32_t seedOffset; // Added to the world seed
+	float frequency;
+};
+
+// Height noise of each biome, indexed by BiomeType
+const BiomeNoiseConfig BIOME_HEIGHT_NOISE[BIOME_COUNT] = {
+	{ 2, 0.01f },  // Forest
+	{ 3, 0.03f },  // Plains
+	{ 1, 0.02f },  // Desert
+	{ 4, 0.018f }, // Mountains
+};
+
+} // namespace
+
+TerrainCache::TerrainCache(uint32_t seed, size_t tileLimit)
+	: m_seed(seed), m_biomeNoise(std::make_unique<fnl_state>(fnlCreateState())), m_caveNoise(std::make_unique<fnl_state>(fnlCreateState())),
+	m_tileLimit(std::max<size_t>(tileLimit, 1))
+{
+	m_biomeNoise->seed = static_cast<int>(seed);
+	m_biomeNoise->noise_type = FNL_NOISE_OPENSIMPLEX2S;
+	m_biomeNoise->frequency = 0.0005f;
+
+	m_caveNoise->seed = static_cast<int>(seed + 5);
+	m_caveNoise->noise_type = FNL_NOISE_OPENSIMPLEX2;
+	m_caveNoise->rotation_type_3d = FNL_ROTATION_IMPROVE_XZ_PLANES;
+	m_caveNoise->frequency = 0.03f;
+
+	// Each noise layer gets its own seed so they don't line up
+	for (const BiomeNoiseConfig& config : BIOME_HEIGHT_NOISE) {
+		m_heightNoise.emplace_back(static_cast<int>(seed + config.seedOffset), config.frequency);
+	}
+}
+
+TerrainCache::~TerrainCache()
+{
+}
+
+float TerrainCache::getBiomeValue(int x, int z)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	int tileX = toTileCoord(x);
+	int tileZ = toTileCoord(z);
+	return interpolate(getTile(tileX, tileZ).biome, x - tileX * TILE_SIZE, z - tileZ * TILE_SIZE);
+}
+
+void TerrainCache::getBiomeValues(int originX, int originZ, int countX, int countZ, float* out)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	const Tile* tile = nullptr;
+	int tileX = 0;
+	int tileZ = 0;
+	for (int i = 0; i < countX; i++) {
+		for (int j = 0; j < countZ; j++) {
+			int x = originX + i;
+			int z = originZ + j;
+			if (tile == nullptr || toTileCoord(x) != tileX || toTileCoord(z) != tileZ) {
+				tileX = toTileCoord(x);
+				tileZ = toTileCoord(z);
+				tile = &getTile(tileX, tileZ);
+			}
+			out[i * countZ + j] = interpolate(tile->biome, x - tileX * TILE_SIZE, z - tileZ * TILE_SIZE);
+		}
+	}
+}
+
+float TerrainCache::getApproximateHeight(int x, int z)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	int tileX = toTileCoord(x);
+	int tileZ = toTileCoord(z);
+	return interpolate(getTile(tileX, tileZ).height, x - tileX * TILE_SIZE, z - tileZ * TILE_SIZE);
+}
+
+int TerrainCache::getSurfaceHeight(int x, int z)
+{
+	BiomeBlends blends = getBiomeBlends(getBiomeValue(x, z));
+	std::array<float, BIOME_COUNT> heightNoise = {};
+	for (const auto& blend : blends) {
+		heightNoise[static_cast<int>(blend.type)] = getHeightNoise(blend.type).get(x, z);
+	}
+	return getTerrainHeight(blends, heightNoise);
+}
+
+float TerrainCache::getCaveNoise(int x, int y, int z) const
+{
+	return fnlGetNoise3D(m_caveNoise.get(), static_cast<FNLfloat>(x), static_cast<FNLfloat>(y), static_cast<FNLfloat>(z));
+}
+
+TerrainCacheStats TerrainCache::getStats() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	TerrainCacheStats stats = m_stats;
+	stats.tileCount = m_tiles.size();
+	stats.tileLimit = m_tileLimit;
+	return stats;
+}
+
+void TerrainCache::setTileLimit(size_t tileLimit)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_tileLimit = std::max<size_t>(tileLimit, 1);
+	evictTiles();
+}
+
+BiomeBlends TerrainCache::getBiomeBlends(float biomeValue)
+{
+	biomeValue = (biomeValue + 1.0f) / 2.0f;
+
+	BiomeBlends blends;
+	if (biomeValue < 0.2f) {
+		blends.add({ BiomeType::Desert, 1.0f - biomeValue / 0.25f });
+		blends.add({ BiomeType::Plains, biomeValue / 0.25f });
+	}
+	else if (biomeValue < 0.5f) {
+		blends.add({ BiomeType::Plains, 1.0f - (biomeValue - 0.25f) / 0.25f });
+		blends.add({ BiomeType::Forest, (biomeValue - 0.25f) / 0.25f });
+	}
+	else if (biomeValue < 0.85f) {
+		blends.add({ BiomeType::Forest, 1.0f - (biomeValue - 0.5f) / 0.25f });
+		blends.add({ BiomeType::Mountains, (biomeValue - 0.5f) / 0.25f });
+	}
+	else {
+		blends.add({ BiomeType::Mountains, 1.0f });
+	}
+
+	return blends;
+}
+
+int TerrainCache::getTerrainHeight(const BiomeBlends& blends, const std::array<float, BIOME_COUNT>& heightNoise)
+{
+	float blendedHeight = 0.0f;
+	float totalWeight = 0.0f;
+	for (const auto& blend : blends) {
+		float noiseValue = heightNoise[static_cast<int>(blend.type)];
+		float biomeMaxHeight = (blend.type == BiomeType::Mountains) ? ((Chunk::CHUNK_SIZE * 3) / 2) : (Chunk::CHUNK_SIZE / 2);
+		blendedHeight += ((noiseValue + 1.0f) * biomeMaxHeight) * blend.weight;
+		totalWeight += blend.weight;
+	}
+
+	int height = static_cast<int>(blendedHeight / totalWeight);
+	return std::clamp(height, 1, Chunk::CHUNK_HEIGHT - 1);
+}
+
+const TerrainCache::Tile& TerrainCache::getTile(int tileX, int tileZ)
+{
+	uint64_t key = tileKey(tileX, tileZ);
+	auto cached = m_tiles.find(key);
+	if (cached != m_tiles.end()) {
+		m_stats.hits++;
+		m_recent.splice(m_recent.begin(), m_recent, cached->second.recent);
+		return *cached->second.tile;
+	}
+
+	m_stats.misses++;
+	m_recent.push_front(key);
+	CachedTile& entry = m_tiles[key];
+	entry.tile = buildTile(tileX, tileZ);
+	entry.recent = m_recent.begin();
+	const Tile& tile = *entry.tile;
+
+	// The new tile is the most recent, it is never the one evicted
+	evictTiles();
+	return tile;
+}
+
+std::unique_ptr<TerrainCache::Tile> TerrainCache::buildTile(int tileX, int tileZ) const
+{
+	auto tile = std::make_unique<Tile>();
+	int originX = tileX * TILE_SIZE;
+	int originZ = tileZ * TILE_SIZE;
+	for (int i = 0; i < SAMPLES; i++) {
+		for (int j = 0; j < SAMPLES; j++) {
+			int x = originX + i * SAMPLE_STEP;
+			int z = originZ + j * SAMPLE_STEP;
+			float biomeValue = fnlGetNoise2D(m_biomeNoise.get(), x, z);
+
+			BiomeBlends blends = getBiomeBlends(biomeValue);
+			std::array<float, BIOME_COUNT> heightNoise = {};
+			for (const auto& blend : blends) {
+				heightNoise[static_cast<int>(blend.type)] = m_heightNoise[static_cast<int>(blend.type)].get(x, z);
+			}
+
+			tile->biome[i * SAMPLES + j] = biomeValue;
+			tile->height[i * SAMPLES + j] = static_cast<float>(getTerrainHeight(blends, heightNoise));
+		}
+	}
+	return tile;
+}
+
+void TerrainCache::evictTiles()
+{
+	while (m_tiles.size() > m_tileLimit) {
+		m_tiles.erase(m_recent.back());
+		m_recent.pop_back();
+		m_stats.evictions++;
+	}
+}
+
+float TerrainCache::interpolate(const std::array<float, SAMPLES * SAMPLES>& samples, int localX, int localZ)
+{
+	int i = localX / SAMPLE_STEP;
+	int j = localZ / SAMPLE_STEP;
+	float fx = static_cast<float>(localX % SAMPLE_STEP) / SAMPLE_STEP;
+	float fz = static_cast<float>(localZ % SAMPLE_STEP) / SAMPLE_STEP;
+
+	const float* row0 = &samples[i * SAMPLES + j];
+	const float* row1 = row0 + SAMPLES;
+	float atX0 = row0[0] + fz * (row0[1] - row0[0]);
+	float atX1 = row1[0] + fz * (row1[1] - row1[0]);
+	return atX0 + fx * (atX1 - atX0);
+}
+
+} // namespace voxl
@@ -0,0 +1,80 @@
+#include "thread_pool.h"
+
+namespace voxl {
+
+ThreadPool::ThreadPool(unsigned int threadCount)
+{
+	if (threadCount == 0) {
+		unsigned int cores = std::thread::hardware_concurrency();
+		threadCount = cores > 1 ? cores - 1 : 1;
+	}
+
+	for (unsigned int i = 0; i < threadCount; i++) {
+		m_workers.emplace_back(&ThreadPool::workerLoop, this);
+	}
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stopping = true;
+		// Jobs not started yet are dropped
+		m_jobs = std::queue<std::function<void()>>();
+	}
+	m_jobAvailable.notify_all();
+
+	for (std::thread& worker : m_workers) {
+		worker.join();
+	}
+}
+
+void ThreadPool::submit(std::function<void()> job)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_jobs.push(std::move(job));
+	}
+	m_jobAvailable.notify_one();
+}
+
+void ThreadPool::wait()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_idle.wait(lock, [this]() { return m_jobs.empty() && m_activeJobs == 0; });
+}
+
+size_t ThreadPool::getPendingCount() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_jobs.size() + m_activeJobs;
+}
+
+void ThreadPool::workerLoop()
+{
+	while (true) {
+		std::function<void()> job;
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_jobAvailable.wait(lock, [this]() { return m_stopping || !m_jobs.empty(); });
+			if (m_stopping) {
+				return;
+			}
+			job = std::move(m_jobs.front());
+			m_jobs.pop();
+			m_activeJobs++;
+		}
+
+		job();
+
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_activeJobs--;
+			if (m_jobs.empty() && m_activeJobs == 0) {
+				m_idle.notify_all();
+			}
+		}
+	}
+}
+
+} // namespace voxl
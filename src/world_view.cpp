@@ -0,0 +1,74 @@
+#include "world_view.h"
+#include "chunk_manager.h"
+
+#include <algorithm>
+
+namespace voxl {
+
+WorldView::WorldView(const ChunkManager& chunkManager, ChunkStage minStage)
+	: m_chunkManager(chunkManager), m_minStage(minStage)
+{
+	m_neighborhood.fill(nullptr);
+}
+
+void WorldView::reset()
+{
+	m_valid = false;
+}
+
+void WorldView::recenter(int chunkX, int chunkZ)
+{
+	for (int dx = -1; dx <= 1; dx++) {
+		for (int dz = -1; dz <= 1; dz++) {
+			Chunk* chunk = m_chunkManager.getChunk(glm::ivec3(chunkX + dx, 0, chunkZ + dz));
+			m_neighborhood[(dx + 1) * 3 + (dz + 1)] = chunk != nullptr && chunk->getStage() >= m_minStage ? chunk : nullptr;
+		}
+	}
+	m_centerX = chunkX;
+	m_centerZ = chunkZ;
+	m_valid = true;
+}
+
+void WorldView::readRegion(const glm::ivec3& min, const glm::ivec3& max, BlockType* out, BlockType fill)
+{
+	int sizeY = max.y - min.y + 1;
+	int sizeZ = max.z - min.z + 1;
+
+	// Part of the box inside the world height
+	int minY = std::max(min.y, 0);
+	int maxY = std::min(max.y, Chunk::CHUNK_HEIGHT - 1);
+
+	for (int x = min.x; x <= max.x; x++) {
+		for (int z = min.z; z <= max.z; z++) {
+			BlockType* column = out + ((x - min.x) * sizeZ + (z - min.z)) * sizeY;
+			const Chunk* chunk = getChunk(x >> CHUNK_SHIFT, z >> CHUNK_SHIFT);
+			if (chunk == nullptr || minY > maxY) {
+				std::fill_n(column, sizeY, fill);
+				continue;
+			}
+
+			std::fill(column, column + (minY - min.y), fill);
+			std::fill(column + (maxY - min.y + 1), column + sizeY, fill);
+
+			// Walk the column a section at a time so uniform sections are a single fill
+			int localX = x & CHUNK_MASK;
+			int localZ = z & CHUNK_MASK;
+			int y = minY;
+			while (y <= maxY) {
+				const ChunkSection& section = chunk->getSection(y / ChunkSection::SIZE);
+				int sectionEnd = std::min(maxY, (y / ChunkSection::SIZE + 1) * ChunkSection::SIZE - 1);
+				if (section.isUniform()) {
+					std::fill(column + (y - min.y), column + (sectionEnd - min.y + 1), section.getUniformType());
+				}
+				else {
+					for (int i = y; i <= sectionEnd; i++) {
+						column[i - min.y] = section.get(localX, i % ChunkSection::SIZE, localZ);
+					}
+				}
+				y = sectionEnd + 1;
+			}
+		}
+	}
+}
+
+} // namespace voxl
@@ -0,0 +1,961 @@
+// Headless benchmark for terrain generation and meshing.
+// Builds only the world code, no window or GL context is created.
+
+#include "chunk.h"
+#include "chunk_manager.h"
+#include "chunk_mesher.h"
+#include "light_engine.h"
+#include "terrain_cache.h"
+#include "thread_pool.h"
+#include "world_view.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Count every heap allocation made by the world code
+static std::atomic<size_t> g_allocationCount{ 0 };
+static std::atomic<size_t> g_allocatedBytes{ 0 };
+
+namespace {
+
+void* countedAlloc(std::size_t size)
+{
+	g_allocationCount.fetch_add(1, std::memory_order_relaxed);
+	g_allocatedBytes.fetch_add(size, std::memory_order_relaxed);
+	if (void* ptr = std::malloc(size ? size : 1)) {
+		return ptr;
+	}
+	throw std::bad_alloc();
+}
+
+// Over-aligned blocks keep the malloc pointer just before the aligned address, so the same code
+// works where aligned_alloc is missing
+void* countedAlignedAlloc(std::size_t size, std::align_val_t align)
+{
+	std::size_t alignment = static_cast<std::size_t>(align);
+	char* base = static_cast<char*>(countedAlloc(size + alignment + sizeof(void*)));
+	std::uintptr_t aligned = (reinterpret_cast<std::uintptr_t>(base) + sizeof(void*) + alignment - 1) & ~(alignment - 1);
+	reinterpret_cast<void**>(aligned)[-1] = base;
+	return reinterpret_cast<void*>(aligned);
+}
+
+void alignedFree(void* ptr)
+{
+	if (ptr != nullptr) {
+		std::free(static_cast<void**>(ptr)[-1]);
+	}
+}
+
+} // namespace
+
+void* operator new(std::size_t size) { return countedAlloc(size); }
+void* operator new[](std::size_t size) { return countedAlloc(size); }
+void* operator new(std::size_t size, std::align_val_t align) { return countedAlignedAlloc(size, align); }
+void* operator new[](std::size_t size, std::align_val_t align) { return countedAlignedAlloc(size, align); }
+
+void operator delete(void* ptr) noexcept { std::free(ptr); }
+void operator delete[](void* ptr) noexcept { std::free(ptr); }
+void operator delete(void* ptr, std::size_t) noexcept { std::free(ptr); }
+void operator delete[](void* ptr, std::size_t) noexcept { std::free(ptr); }
+void operator delete(void* ptr, std::align_val_t) noexcept { alignedFree(ptr); }
+void operator delete[](void* ptr, std::align_val_t) noexcept { alignedFree(ptr); }
+void operator delete(void* ptr, std::size_t, std::align_val_t) noexcept { alignedFree(ptr); }
+void operator delete[](void* ptr, std::size_t, std::align_val_t) noexcept { alignedFree(ptr); }
+
+namespace {
+
+struct BenchOptions {
+	int gridSize = 8;
+	std::vector<unsigned int> seeds;
+	bool verify = false;
+};
+
+struct StageResult {
+	double seconds = 0.0;
+	size_t allocations = 0;
+	size_t allocatedBytes = 0;
+};
+
+// Runs a stage and records its wall time and allocations
+template <typename Func>
+StageResult measure(Func&& func)
+{
+	size_t allocations = g_allocationCount.load();
+	size_t bytes = g_allocatedBytes.load();
+	auto start = std::chrono::steady_clock::now();
+
+	func();
+
+	StageResult result;
+	result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	result.allocations = g_allocationCount.load() - allocations;
+	result.allocatedBytes = g_allocatedBytes.load() - bytes;
+	return result;
+}
+
+void printStage(const char* name, const StageResult& result, size_t chunkCount, size_t faceCount)
+{
+	double blocks = static_cast<double>(chunkCount) * voxl::Chunk::CHUNK_SIZE * voxl::Chunk::CHUNK_HEIGHT * voxl::Chunk::CHUNK_SIZE;
+	printf("  %-12s %10.2f %12.1f ", name, result.seconds * 1000.0, chunkCount / result.seconds);
+	if (faceCount > 0) {
+		printf("%12.3e ", faceCount / result.seconds);
+	}
+	else {
+		printf("%12s ", "-");
+	}
+	printf("%10.2f %10zu %10.2f\n", result.seconds * 1e9 / blocks, result.allocations, result.allocatedBytes / (1024.0 * 1024.0));
+}
+
+void printUsage(const char* program)
+{
+	printf("Usage: %s [--grid N] [--seed S]... [--verify]\n", program);
+	printf("  --grid N   generate and mesh an N x N grid of chunks (default 8)\n");
+	printf("  --seed S   world seed to benchmark, can be repeated (default 1, 42, 1337)\n");
+	printf("  --verify   run the correctness checks instead of benchmarking\n");
+}
+
+bool parseOptions(int argc, char** argv, BenchOptions& options)
+{
+	for (int i = 1; i < argc; i++) {
+		if (std::strcmp(argv[i], "--grid") == 0 && i + 1 < argc) {
+			options.gridSize = std::atoi(argv[++i]);
+		}
+		else if (std::strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+			options.seeds.push_back(static_cast<unsigned int>(std::strtoul(argv[++i], nullptr, 10)));
+		}
+		else if (std::strcmp(argv[i], "--verify") == 0) {
+			options.verify = true;
+		}
+		else {
+			return false;
+		}
+	}
+
+	if (options.seeds.empty()) {
+		options.seeds = { 1, 42, 1337 };
+	}
+	return options.gridSize > 0;
+}
+
+// FNV-1a over every voxel of the chunk
+uint64_t hashChunk(const voxl::Chunk& chunk)
+{
+	std::vector<voxl::BlockType> blocks(voxl::ChunkSection::VOLUME);
+	uint64_t hash = 0xCBF29CE484222325ull;
+	for (int i = 0; i < voxl::Chunk::SECTION_COUNT; i++) {
+		chunk.getSection(i).store(blocks.data());
+		for (voxl::BlockType type : blocks) {
+			hash = (hash ^ static_cast<uint8_t>(type)) * 0x100000001B3ull;
+		}
+	}
+	return hash;
+}
+
+// Generates the grid, centered on the origin, once in order on this thread and once in reverse
+// order on the workers, then hands the decorations that cross chunk borders to their neighbors in
+// the same orders. Every chunk must hash the same both times.
+// World hashes of the default 8x8 grid. Generation changes that alter the world on purpose
+// update these, anything else drifting from them is a bug.
+struct PinnedHash {
+	unsigned int seed;
+	uint64_t worldHash;
+};
+const PinnedHash PINNED_HASHES[] = {
+	{ 1, 0x0f8d35020ee3bc7dull },
+	{ 42, 0xec144490791c74c0ull },
+	{ 1337, 0x671d5cbe2117ba13ull },
+};
+const int PINNED_GRID_SIZE = 8;
+
+int verifyGeneration(const BenchOptions& options, voxl::ThreadPool& workers)
+{
+	const int gridSize = options.gridSize;
+	const int offset = gridSize / 2;
+	const size_t chunkCount = static_cast<size_t>(gridSize) * gridSize;
+	int failures = 0;
+
+	using ChunkGrid = std::vector<std::unique_ptr<voxl::Chunk>>;
+	auto generateChunk = [&](voxl::TerrainCache& terrain, size_t i) {
+		int x = static_cast<int>(i) / gridSize - offset;
+		int z = static_cast<int>(i) % gridSize - offset;
+		auto chunk = std::make_unique<voxl::Chunk>(x * voxl::Chunk::CHUNK_SIZE, 0, z * voxl::Chunk::CHUNK_SIZE, nullptr);
+		chunk->generate(terrain);
+		return chunk;
+	};
+	// Writes landing outside the grid are dropped, the chunks at the edge are incomplete either way
+	auto applyWrites = [&](ChunkGrid& chunks, size_t i) {
+		for (const voxl::DecorationWrite& write : chunks[i]->takeOutgoingWrites()) {
+			int x = static_cast<int>(std::floor(write.x / static_cast<float>(voxl::Chunk::CHUNK_SIZE))) + offset;
+			int z = static_cast<int>(std::floor(write.z / static_cast<float>(voxl::Chunk::CHUNK_SIZE))) + offset;
+			if (x >= 0 && x < gridSize && z >= 0 && z < gridSize) {
+				chunks[static_cast<size_t>(x) * gridSize + z]->applyDecorationWrite(write);
+			}
+		}
+	};
+
+	for (unsigned int seed : options.seeds) {
+		// A fresh terrain cache per pass, tiles built in a different order must not change anything
+		voxl::TerrainCache serialTerrain(seed);
+		voxl::TerrainCache parallelTerrain(seed);
+
+		ChunkGrid serialChunks(chunkCount);
+		for (size_t i = 0; i < chunkCount; i++) {
+			serialChunks[i] = generateChunk(serialTerrain, i);
+		}
+		for (size_t i = 0; i < chunkCount; i++) {
+			applyWrites(serialChunks, i);
+		}
+
+		ChunkGrid parallelChunks(chunkCount);
+		for (size_t i = chunkCount; i-- > 0;) {
+			workers.submit([&, i]() { parallelChunks[i] = generateChunk(parallelTerrain, i); });
+		}
+		workers.wait();
+		for (size_t i = chunkCount; i-- > 0;) {
+			applyWrites(parallelChunks, i);
+		}
+
+		std::vector<uint64_t> serial(chunkCount);
+		std::vector<uint64_t> parallel(chunkCount);
+		for (size_t i = 0; i < chunkCount; i++) {
+			serial[i] = hashChunk(*serialChunks[i]);
+			parallel[i] = hashChunk(*parallelChunks[i]);
+		}
+
+		size_t mismatches = 0;
+		uint64_t worldHash = 0xCBF29CE484222325ull;
+		for (size_t i = 0; i < chunkCount; i++) {
+			mismatches += serial[i] != parallel[i] ? 1 : 0;
+			worldHash = (worldHash ^ serial[i]) * 0x100000001B3ull;
+		}
+
+		printf("seed %u, %dx%d chunks: world hash %016llx, %zu mismatches\n",
+			seed, gridSize, gridSize, static_cast<unsigned long long>(worldHash), mismatches);
+		failures += mismatches > 0 ? 1 : 0;
+
+		for (const PinnedHash& pinned : PINNED_HASHES) {
+			if (gridSize == PINNED_GRID_SIZE && pinned.seed == seed && pinned.worldHash != worldHash) {
+				printf("seed %u: world hash changed, expected %016llx\n", seed, static_cast<unsigned long long>(pinned.worldHash));
+				failures++;
+			}
+		}
+	}
+
+	return failures > 0 ? 1 : 0;
+}
+
+// Reads random boxes through WorldView::readRegion and compares them with per-block queries. The
+// boxes reach past the loaded chunks and the world height, where they must read as the fill.
+int verifyRegionReads(const BenchOptions& options)
+{
+	const int boxCount = 2000;
+	const int maxSize = 40;
+	const int extent = 2 * (voxl::ChunkManager::LOAD_RADIUS + 2) * voxl::Chunk::CHUNK_SIZE;
+	int failures = 0;
+
+	for (unsigned int seed : options.seeds) {
+		voxl::ChunkManager chunkManager("", seed);
+		chunkManager.loadChunks(glm::vec3(0.0f));
+
+		voxl::WorldView regionView(chunkManager);
+		voxl::WorldView blockView(chunkManager);
+		std::vector<voxl::BlockType> region;
+		size_t blockCount = 0;
+		size_t mismatches = 0;
+
+		uint32_t state = seed;
+		auto next = [&state]() { return state = state * 1664525u + 1013904223u, state >> 8; };
+		for (int i = 0; i < boxCount; i++) {
+			glm::ivec3 min(static_cast<int>(next() % extent) - extent / 2, static_cast<int>(next() % 160) - 16,
+				static_cast<int>(next() % extent) - extent / 2);
+			glm::ivec3 max = min + glm::ivec3(next() % maxSize, next() % maxSize, next() % maxSize);
+			voxl::BlockType fill = i % 2 == 0 ? voxl::BlockType::None : voxl::BlockType::Stone;
+
+			region.resize(static_cast<size_t>(max.x - min.x + 1) * (max.y - min.y + 1) * (max.z - min.z + 1));
+			regionView.readRegion(min, max, region.data(), fill);
+
+			const voxl::BlockType* read = region.data();
+			for (int x = min.x; x <= max.x; x++) {
+				for (int z = min.z; z <= max.z; z++) {
+					bool loaded = blockView.getChunkAt(x, z) != nullptr;
+					for (int y = min.y; y <= max.y; y++) {
+						bool inside = loaded && y >= 0 && y < voxl::Chunk::CHUNK_HEIGHT;
+						mismatches += *read++ != (inside ? blockView.get(x, y, z) : fill) ? 1 : 0;
+						blockCount++;
+					}
+				}
+			}
+		}
+
+		printf("seed %u, region reads: %zu blocks, %zu differ from per-block reads\n", seed, blockCount, mismatches);
+		failures += mismatches > 0 ? 1 : 0;
+	}
+
+	return failures > 0 ? 1 : 0;
+}
+
+// Walks a memory-only world far enough for the out of view chunks to outgrow the memory budget.
+// Nothing can be saved, so the budget only holds if chunks that were never edited get dropped.
+int verifyMemoryBudget(const BenchOptions& options)
+{
+	const float step = 4.0f * voxl::ChunkManager::UNLOAD_RADIUS * voxl::Chunk::CHUNK_SIZE;
+	int failures = 0;
+
+	for (unsigned int seed : options.seeds) {
+		voxl::ChunkManager chunkManager("", seed);
+		chunkManager.loadChunks(glm::vec3(0.0f));
+
+		// Room for the loaded chunks and about as many again out of view
+		size_t budget = 2 * chunkManager.getCacheStats().usedBytes;
+		chunkManager.setMemoryBudget(budget);
+
+		// The running total against the chunks measured one by one, nothing is meshed headless
+		size_t peakBytes = 0;
+		size_t driftBytes = 0;
+		for (int i = 1; i <= 4; i++) {
+			chunkManager.loadChunks(glm::vec3(i * step, 0.0f, 0.0f));
+			size_t usedBytes = chunkManager.getCacheStats().usedBytes;
+			voxl::ChunkMemoryStats memory = chunkManager.getMemoryStats();
+			size_t measuredBytes = memory.voxelBytes + memory.lightBytes;
+			peakBytes = std::max(peakBytes, usedBytes);
+			driftBytes = std::max(driftBytes, usedBytes > measuredBytes ? usedBytes - measuredBytes : measuredBytes - usedBytes);
+		}
+
+		voxl::ChunkCacheStats stats = chunkManager.getCacheStats();
+		bool withinBudget = peakBytes <= budget;
+		printf("seed %u, memory budget %.2f MiB: peak %.2f MiB, %zu chunks evicted, %zu bytes miscounted%s\n", seed, budget / (1024.0 * 1024.0),
+			peakBytes / (1024.0 * 1024.0), stats.chunkEvictions, driftBytes, withinBudget ? "" : ", OVER BUDGET");
+		failures += withinBudget && driftBytes == 0 ? 0 : 1;
+	}
+
+	return failures > 0 ? 1 : 0;
+}
+
+// Clears the leaves of a chunk by the origin, trees of its neighbors included, and moves away far
+// enough for the neighbors to be evicted. Coming back generates them again, their trees must not
+// grow back into the edited chunk, and their writes must not be queued a second time.
+int verifyDecorationReplay(const BenchOptions& options)
+{
+	const float step = 4.0f * voxl::ChunkManager::UNLOAD_RADIUS * voxl::Chunk::CHUNK_SIZE;
+	const int size = voxl::Chunk::CHUNK_SIZE;
+	int failures = 0;
+
+	auto countLeaves = [](const voxl::Chunk& chunk) {
+		size_t count = 0;
+		for (int section = 0; section < voxl::Chunk::SECTION_COUNT; section++) {
+			count += chunk.getSection(section).getCount(voxl::BlockType::Leaves);
+		}
+		return count;
+	};
+
+	for (unsigned int seed : options.seeds) {
+		voxl::ChunkManager chunkManager("", seed);
+		chunkManager.loadChunks(glm::vec3(0.0f));
+
+		glm::ivec3 editedPos(0);
+		for (int x = -1; x <= 1; x++) {
+			for (int z = -1; z <= 1; z++) {
+				glm::ivec3 chunkPos(x, 0, z);
+				if (countLeaves(*chunkManager.getChunk(chunkPos)) > countLeaves(*chunkManager.getChunk(editedPos))) {
+					editedPos = chunkPos;
+				}
+			}
+		}
+
+		voxl::Chunk* edited = chunkManager.getChunk(editedPos);
+		size_t removed = 0;
+		for (int x = 0; x < size; x++) {
+			for (int z = 0; z < size; z++) {
+				for (int y = 0; y < voxl::Chunk::CHUNK_HEIGHT; y++) {
+					if (edited->getBlockType(x, y, z) == voxl::BlockType::Leaves) {
+						edited->setBlockType(x, y, z, voxl::BlockType::None);
+						chunkManager.markBlockDirty(edited, glm::ivec3(x, y, z));
+						removed++;
+					}
+				}
+			}
+		}
+
+		chunkManager.setMemoryBudget(1);
+		chunkManager.loadChunks(glm::vec3(step, 0.0f, 0.0f));
+		size_t pendingBefore = chunkManager.getStageStats().pendingWriteCount;
+		chunkManager.loadChunks(glm::vec3(0.0f));
+		size_t regrown = countLeaves(*chunkManager.getChunk(editedPos));
+		chunkManager.loadChunks(glm::vec3(step, 0.0f, 0.0f));
+		size_t pendingAfter = chunkManager.getStageStats().pendingWriteCount;
+
+		voxl::ChunkCacheStats stats = chunkManager.getCacheStats();
+		bool passed = stats.chunkEvictions > 0 && regrown == 0 && pendingAfter == pendingBefore;
+		printf("seed %u, decoration replay: %zu leaves removed, %zu grew back, %zu chunks evicted, pending writes %zu -> %zu\n",
+			seed, removed, regrown, stats.chunkEvictions, pendingBefore, pendingAfter);
+		failures += passed ? 0 : 1;
+	}
+
+	return failures > 0 ? 1 : 0;
+}
+
+// Light of every lit chunk computed from scratch with one flood fill over the whole world, the
+// way LightEngine defines it, to compare the incremental results against
+class ReferenceLight {
+public:
+	explicit ReferenceLight(const voxl::ChunkManager& chunkManager) : m_chunkManager(chunkManager) {}
+
+	void compute()
+	{
+		m_light.clear();
+		m_view.reset();
+		m_lastLight = nullptr;
+		for (const voxl::ChunkEntry& entry : m_chunkManager.getChunks()) {
+			if (entry.chunk->getStage() >= voxl::ChunkStage::Lit) {
+				m_light[entry.chunkPos].assign(VOLUME, 0);
+			}
+		}
+
+		// Open sky down to the first block of each column, and every light source
+		for (auto& [chunkPos, light] : m_light) {
+			const voxl::Chunk& chunk = *m_chunkManager.getChunk(chunkPos);
+			// Sections without a light source are skipped when looking for one
+			std::array<bool, voxl::Chunk::SECTION_COUNT> emitting = {};
+			for (int section = 0; section < voxl::Chunk::SECTION_COUNT; section++) {
+				for (int type = 0; type < voxl::BLOCK_TYPE_COUNT; type++) {
+					voxl::BlockType blockType = static_cast<voxl::BlockType>(type);
+					emitting[section] = emitting[section] || (voxl::getLightEmission(blockType) > 0 && chunk.getSection(section).getCount(blockType) > 0);
+				}
+			}
+			for (int x = 0; x < SIZE; x++) {
+				for (int z = 0; z < SIZE; z++) {
+					glm::ivec3 column(chunkPos.x * SIZE + x, 0, chunkPos.z * SIZE + z);
+					for (int y = voxl::Chunk::CHUNK_HEIGHT - 1; y >= 0 && chunk.getBlockType(x, y, z) == voxl::BlockType::None; y--) {
+						light[index(x, y, z)] = voxl::LightSection::pack(voxl::MAX_LIGHT_LEVEL, 0);
+					}
+					for (int y = 0; y < voxl::Chunk::CHUNK_HEIGHT; y++) {
+						if (!emitting[y / voxl::ChunkSection::SIZE]) {
+							y += voxl::ChunkSection::SIZE - 1;
+							continue;
+						}
+						int emission = voxl::getLightEmission(chunk.getBlockType(x, y, z));
+						if (emission > 0) {
+							uint8_t& voxel = light[index(x, y, z)];
+							voxel = voxl::LightSection::pack(voxl::LightSection::getSky(voxel), emission);
+							m_queue.push_back({ column + glm::ivec3(0, y, 0), 1 });
+						}
+					}
+				}
+			}
+		}
+
+		const glm::ivec3 directions[6] = { { -1, 0, 0 }, { 1, 0, 0 }, { 0, -1, 0 }, { 0, 1, 0 }, { 0, 0, -1 }, { 0, 0, 1 } };
+
+		// Sky light only spreads from open sky next to a voxel that isn't, the rest is full already.
+		// Open sky is the top of each column, once the columns around are open too so is everything above.
+		for (auto& [chunkPos, light] : m_light) {
+			for (int x = 0; x < SIZE; x++) {
+				for (int z = 0; z < SIZE; z++) {
+					glm::ivec3 column(chunkPos.x * SIZE + x, 0, chunkPos.z * SIZE + z);
+					int y = voxl::Chunk::CHUNK_HEIGHT;
+					while (y > 0 && voxl::LightSection::getSky(light[index(x, y - 1, z)]) == voxl::MAX_LIGHT_LEVEL) {
+						y--;
+					}
+
+					for (bool darkAround = true; darkAround && y < voxl::Chunk::CHUNK_HEIGHT; y++) {
+						glm::ivec3 pos = column + glm::ivec3(0, y, 0);
+						darkAround = false;
+						bool darkBelow = false;
+						for (int d = 0; d < 6; d++) {
+							glm::ivec3 next = pos + directions[d];
+							uint8_t* voxel = next.y >= 0 && next.y < voxl::Chunk::CHUNK_HEIGHT ? find(next) : nullptr;
+							bool dark = voxel != nullptr && voxl::LightSection::getSky(*voxel) < voxl::MAX_LIGHT_LEVEL;
+							(d == 2 || d == 3 ? darkBelow : darkAround) |= dark;
+						}
+						if (darkAround || darkBelow) {
+							m_queue.push_back({ pos, 0 });
+						}
+					}
+				}
+			}
+		}
+
+		for (size_t head = 0; head < m_queue.size(); head++) {
+			auto [pos, channel] = m_queue[head];
+			int level = getLevel(*find(pos), channel);
+			for (int d = 0; d < 6; d++) {
+				glm::ivec3 next = pos + directions[d];
+				uint8_t* voxel = next.y >= 0 && next.y < voxl::Chunk::CHUNK_HEIGHT ? find(next) : nullptr;
+				if (voxel == nullptr) {
+					continue;
+				}
+				int absorption = voxl::getLightAbsorption(getBlockType(next));
+				bool skyColumn = channel == 0 && d == 2 && level == voxl::MAX_LIGHT_LEVEL && absorption == 0;
+				int nextLevel = skyColumn ? voxl::MAX_LIGHT_LEVEL : level - 1 - absorption;
+				if (nextLevel > getLevel(*voxel, channel)) {
+					*voxel = channel == 0 ? voxl::LightSection::pack(nextLevel, voxl::LightSection::getBlock(*voxel))
+						: voxl::LightSection::pack(voxl::LightSection::getSky(*voxel), nextLevel);
+					m_queue.push_back({ next, channel });
+				}
+			}
+		}
+		m_queue.clear();
+	}
+
+	// Voxels of lit chunks whose light differs from the reference. Only chunks with every chunk
+	// within 2 loaded are compared, light from chunks unloaded since is left in the others.
+	size_t countMismatches() const
+	{
+		size_t mismatches = 0;
+		for (const auto& [chunkPos, light] : m_light) {
+			bool surrounded = true;
+			for (int dx = -2; dx <= 2; dx++) {
+				for (int dz = -2; dz <= 2; dz++) {
+					surrounded = surrounded && m_chunkManager.getChunk(chunkPos + glm::ivec3(dx, 0, dz)) != nullptr;
+				}
+			}
+			if (!surrounded) {
+				continue;
+			}
+
+			const voxl::Chunk& chunk = *m_chunkManager.getChunk(chunkPos);
+			for (int x = 0; x < SIZE; x++) {
+				for (int z = 0; z < SIZE; z++) {
+					for (int y = 0; y < voxl::Chunk::CHUNK_HEIGHT; y++) {
+						mismatches += chunk.getLight(x, y, z) != light[index(x, y, z)] ? 1 : 0;
+					}
+				}
+			}
+		}
+		return mismatches;
+	}
+
+private:
+	static const int SIZE = voxl::Chunk::CHUNK_SIZE;
+	static const int VOLUME = SIZE * SIZE * voxl::Chunk::CHUNK_HEIGHT;
+
+	const voxl::ChunkManager& m_chunkManager;
+	voxl::WorldView m_view{ m_chunkManager };
+	std::unordered_map<glm::ivec3, std::vector<uint8_t>> m_light;
+	std::vector<std::pair<glm::ivec3, int>> m_queue; // Channel 0 is sky, 1 is block
+	glm::ivec3 m_lastChunkPos = glm::ivec3(0);
+	uint8_t* m_lastLight = nullptr;
+
+	static int index(int x, int y, int z) { return (x * SIZE + z) * voxl::Chunk::CHUNK_HEIGHT + y; }
+	static int getLevel(uint8_t light, int channel) { return channel == 0 ? voxl::LightSection::getSky(light) : voxl::LightSection::getBlock(light); }
+	static glm::ivec3 getChunkPos(const glm::ivec3& pos) { return glm::ivec3(pos.x >> 5, 0, pos.z >> 5); }
+
+	uint8_t* find(const glm::ivec3& pos)
+	{
+		// Most steps stay in the chunk of the step before
+		glm::ivec3 chunkPos = getChunkPos(pos);
+		if (chunkPos != m_lastChunkPos || m_lastLight == nullptr) {
+			auto it = m_light.find(chunkPos);
+			if (it == m_light.end()) {
+				return nullptr;
+			}
+			m_lastChunkPos = chunkPos;
+			m_lastLight = it->second.data();
+		}
+		return m_lastLight + index(pos.x & (SIZE - 1), pos.y, pos.z & (SIZE - 1));
+	}
+	voxl::BlockType getBlockType(const glm::ivec3& pos)
+	{
+		// Through a view, a plain lookup per voxel would dominate the fill
+		return m_view.get(pos);
+	}
+};
+
+// Lights a world as the stages do, edits blocks around the surface the way the player does and
+// moves across it, and checks after each round that the incremental light matches a flood fill
+// of the whole world from scratch
+int verifyLight(const BenchOptions& options)
+{
+	const voxl::BlockType editTypes[] = { voxl::BlockType::None, voxl::BlockType::Stone, voxl::BlockType::Lamp, voxl::BlockType::Water };
+	const int editCount = 300;
+	const int editExtent = 200;
+	int failures = 0;
+
+	for (unsigned int seed : options.seeds) {
+		voxl::ChunkManager chunkManager("", seed);
+		voxl::LightEngine lightEngine(chunkManager);
+		ReferenceLight reference(chunkManager);
+
+		chunkManager.loadChunks(glm::vec3(0.0f));
+		reference.compute();
+		size_t mismatches = reference.countMismatches();
+
+		uint32_t state = seed;
+		auto next = [&state]() { return state = state * 1664525u + 1013904223u, state >> 8; };
+		for (int round = 0; round < 3; round++) {
+			for (int i = 0; i < editCount; i++) {
+				int x = static_cast<int>(next() % editExtent) - editExtent / 2;
+				int z = static_cast<int>(next() % editExtent) - editExtent / 2;
+				int surface = chunkManager.getTerrain().getSurfaceHeight(x, z);
+				int y = std::clamp(surface + static_cast<int>(next() % 16) - 10, 0, voxl::Chunk::CHUNK_HEIGHT - 1);
+				voxl::Chunk* chunk = chunkManager.getChunk(static_cast<float>(x), static_cast<float>(y), static_cast<float>(z));
+				if (chunk == nullptr) {
+					continue;
+				}
+
+				// Shafts of air sometimes, they let the sky light down
+				int depth = next() % 8 == 0 ? 10 : 1;
+				voxl::BlockType type = depth > 1 ? voxl::BlockType::None : editTypes[next() % 4];
+				for (int k = 0; k < depth && y - k >= 0; k++) {
+					chunk->setBlockType(x & (voxl::Chunk::CHUNK_SIZE - 1), y - k, z & (voxl::Chunk::CHUNK_SIZE - 1), type);
+					lightEngine.updateBlock(glm::ivec3(x, y - k, z));
+				}
+			}
+			lightEngine.takeChangedBlocks();
+
+			chunkManager.loadChunks(glm::vec3(64.0f * (round + 1), 0.0f, -32.0f * round));
+			reference.compute();
+			mismatches += reference.countMismatches();
+		}
+
+		printf("seed %u, light: %zu voxels differ from a full flood fill\n", seed, mismatches);
+		failures += mismatches > 0 ? 1 : 0;
+	}
+
+	return failures > 0 ? 1 : 0;
+}
+
+// Ambient occlusion of a face corner recomputed from the blocks around it: the two blocks beside
+// the corner and the one diagonal to it, in the layer of voxels the face looks into
+int getCornerOcclusion(const voxl::ChunkSnapshot& snapshot, const std::array<glm::ivec3, 4>& corners, int corner, int face)
+{
+	const int normalAxis = face / 2;
+	const int axisU = (normalAxis + 1) % 3;
+	const int axisV = (normalAxis + 2) % 3;
+	const glm::ivec3& point = corners[corner];
+	glm::ivec3 cornerSum = corners[0] + corners[1] + corners[2] + corners[3]; // 4 times the cell center
+
+	// Voxel in front of the face touching the corner from inside the cell, and the ones past its sides
+	glm::ivec3 inside;
+	inside[normalAxis] = face % 2 == 1 ? point[normalAxis] : point[normalAxis] - 1;
+	inside[axisU] = cornerSum[axisU] < 4 * point[axisU] ? point[axisU] - 1 : point[axisU];
+	inside[axisV] = cornerSum[axisV] < 4 * point[axisV] ? point[axisV] - 1 : point[axisV];
+	glm::ivec3 sideU = inside;
+	sideU[axisU] = inside[axisU] == point[axisU] ? point[axisU] - 1 : point[axisU];
+	glm::ivec3 sideV = inside;
+	sideV[axisV] = inside[axisV] == point[axisV] ? point[axisV] - 1 : point[axisV];
+	glm::ivec3 diagonal = sideU;
+	diagonal[axisV] = sideV[axisV];
+
+	auto opaque = [&](const glm::ivec3& pos) {
+		return voxl::isOpaque(snapshot.get(pos.x, pos.y - snapshot.getSection() * voxl::ChunkSection::SIZE, pos.z)) ? 1 : 0;
+	};
+	int u = opaque(sideU);
+	int v = opaque(sideV);
+	return u && v ? 0 : 3 - (u + v + opaque(diagonal));
+}
+
+// Ambient occlusion of the same corner the way the fragment shader reads it from the section's
+// occlusion map: the voxel in front of the fragment at the cell center, then the blocks on the
+// side of the corner
+int getMapOcclusion(const std::vector<uint32_t>& columns, int section, const std::array<glm::ivec3, 4>& corners, int corner, int face)
+{
+	const int size = voxl::ChunkSnapshot::SIZE;
+	const int normalAxis = face / 2;
+	const int axisU = (normalAxis + 1) % 3;
+	const int axisV = (normalAxis + 2) % 3;
+	const glm::ivec3 sectionOffset(0, section * voxl::ChunkSection::SIZE, 0);
+
+	glm::vec3 pos = glm::vec3(corners[0] + corners[1] + corners[2] + corners[3] - 4 * sectionOffset) * 0.25f;
+	glm::ivec3 front = glm::clamp(glm::ivec3(glm::floor(pos)), glm::ivec3(0), glm::ivec3(voxl::ChunkSection::SIZE - 1));
+	int plane = static_cast<int>(std::lround(pos[normalAxis]));
+	front[normalAxis] = face % 2 == 1 ? plane : plane - 1;
+
+	glm::ivec3 point = corners[corner] - sectionOffset;
+	glm::ivec3 stepU(0);
+	glm::ivec3 stepV(0);
+	stepU[axisU] = point[axisU] > front[axisU] ? 1 : -1;
+	stepV[axisV] = point[axisV] > front[axisV] ? 1 : -1;
+
+	auto opaque = [&](const glm::ivec3& block) {
+		int bit = block.y + 1;
+		uint32_t word = columns[2 * ((block.z + 1) * size + (block.x + 1)) + bit / 32];
+		return static_cast<int>((word >> (bit % 32)) & 1u);
+	};
+	int u = opaque(front + stepU);
+	int v = opaque(front + stepV);
+	return u && v ? 0 : 3 - (u + v + opaque(front + stepU + stepV));
+}
+
+// Meshes the sections around the origin with both meshers. For every face cell the quads cover,
+// the occlusion the shader reads from the mesh's occlusion map has to match a recompute of the
+// corners from the snapshot.
+int verifyOcclusion(const BenchOptions& options)
+{
+	const int radius = 3;
+	int failures = 0;
+
+	for (unsigned int seed : options.seeds) {
+		voxl::ChunkManager chunkManager("", seed);
+		chunkManager.loadChunks(glm::vec3(0.0f));
+
+		size_t cellCount = 0;
+		size_t wrongCorners = 0;
+		for (int chunkX = -radius; chunkX <= radius; chunkX++) {
+			for (int chunkZ = -radius; chunkZ <= radius; chunkZ++) {
+				const voxl::Chunk& chunk = *chunkManager.getChunk(glm::ivec3(chunkX, 0, chunkZ));
+				for (int section = 0; section < voxl::Chunk::SECTION_COUNT; section++) {
+					voxl::ChunkSnapshot snapshot(chunk, section, chunkManager);
+					for (voxl::MeshingMode mode : { voxl::MeshingMode::Naive, voxl::MeshingMode::Greedy }) {
+						voxl::ChunkMeshData data = voxl::ChunkMesher::buildMesh(snapshot, mode);
+						for (const std::vector<voxl::ChunkVertex>* vertices : { &data.vertices, &data.waterVertices }) {
+							for (size_t quad = 0; quad < vertices->size() / 4; quad++) {
+								glm::ivec3 low(INT32_MAX);
+								glm::ivec3 high(INT32_MIN);
+								int face = 0;
+								for (int k = 0; k < 4; k++) {
+									const voxl::ChunkVertex& vertex = (*vertices)[quad * 4 + k];
+									glm::ivec3 point(vertex.position & 63, (vertex.position >> 6) & 255, (vertex.position >> 14) & 63);
+									low = glm::min(low, point);
+									high = glm::max(high, point);
+									face = (vertex.position >> 20) & 7;
+								}
+
+								// Unit cells of the quad, each checked at its four corners
+								const int axisU = (face / 2 + 1) % 3;
+								const int axisV = (face / 2 + 2) % 3;
+								for (int a = low[axisU]; a < high[axisU]; a++) {
+									for (int b = low[axisV]; b < high[axisV]; b++) {
+										std::array<glm::ivec3, 4> corners = { low, low, low, low };
+										corners[0][axisU] = a;
+										corners[0][axisV] = b;
+										corners[1] = corners[0];
+										corners[1][axisU]++;
+										corners[2] = corners[1];
+										corners[2][axisV]++;
+										corners[3] = corners[0];
+										corners[3][axisV]++;
+										for (int k = 0; k < 4; k++) {
+											int expected = getCornerOcclusion(snapshot, corners, k, face);
+											wrongCorners += getMapOcclusion(data.occlusionColumns, section, corners, k, face) != expected ? 1 : 0;
+										}
+										cellCount++;
+									}
+								}
+							}
+						}
+					}
+				}
+			}
+		}
+
+		printf("seed %u, occlusion: %zu face cells, %zu wrong corners\n", seed, cellCount, wrongCorners);
+		failures += wrongCorners > 0 ? 1 : 0;
+	}
+
+	return failures > 0 ? 1 : 0;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+	BenchOptions options;
+	if (!parseOptions(argc, argv, options)) {
+		printUsage(argv[0]);
+		return 1;
+	}
+
+	const int gridSize = options.gridSize;
+	const size_t chunkCount = static_cast<size_t>(gridSize) * gridSize;
+
+	voxl::ThreadPool workers;
+	printf("%zu mesh worker threads\n\n", workers.getThreadCount());
+
+	if (options.verify) {
+		int failures = verifyGeneration(options, workers);
+		failures += verifyRegionReads(options);
+		failures += verifyMemoryBudget(options);
+		failures += verifyDecorationReplay(options);
+		failures += verifyLight(options);
+		failures += verifyOcclusion(options);
+		return failures > 0 ? 1 : 0;
+	}
+
+	for (unsigned int seed : options.seeds) {
+		voxl::ChunkManager chunkManager("", seed);
+		std::vector<voxl::Chunk*> chunks;
+		chunks.reserve(chunkCount);
+
+		printf("seed %u, %dx%d chunks\n", seed, gridSize, gridSize);
+		printf("  %-12s %10s %12s %12s %10s %10s %10s\n", "stage", "total ms", "chunks/s", "faces/s", "ns/block", "allocs", "alloc MiB");
+
+		StageResult generate = measure([&]() {
+			for (int x = 0; x < gridSize; x++) {
+				for (int z = 0; z < gridSize; z++) {
+					voxl::Chunk* chunk = new voxl::Chunk(x * voxl::Chunk::CHUNK_SIZE, 0, z * voxl::Chunk::CHUNK_SIZE, &chunkManager);
+					chunk->generate(chunkManager.getTerrain());
+					chunks.push_back(chunk);
+				}
+			}
+		});
+
+		// Register the chunks so meshing sees its neighbors
+		for (voxl::Chunk* chunk : chunks) {
+			glm::vec3 position = chunk->getPosition();
+			chunkManager.addChunk(glm::ivec3(position.x / voxl::Chunk::CHUNK_SIZE, 0, position.z / voxl::Chunk::CHUNK_SIZE), chunk);
+		}
+
+		// Light the chunks in generation order, as the Lit stage does, so meshes carry real light
+		voxl::LightEngine lightEngine(chunkManager);
+		StageResult light = measure([&]() {
+			for (voxl::Chunk* chunk : chunks) {
+				glm::vec3 position = chunk->getPosition();
+				chunk->setStage(voxl::ChunkStage::Lit);
+				lightEngine.lightChunk(glm::ivec3(position.x / voxl::Chunk::CHUNK_SIZE, 0, position.z / voxl::Chunk::CHUNK_SIZE));
+			}
+		});
+
+		// Random block lookups through the manager, as raycasts and collisions do them
+		const size_t queryCount = 1000000;
+		size_t solidBlocks = 0;
+		StageResult queries = measure([&]() {
+			uint32_t state = seed;
+			const float extent = static_cast<float>(gridSize * voxl::Chunk::CHUNK_SIZE);
+			for (size_t i = 0; i < queryCount; i++) {
+				state = state * 1664525u + 1013904223u;
+				float x = (state >> 8) % 4096 / 4096.0f * extent;
+				float y = (state >> 4) % voxl::Chunk::CHUNK_HEIGHT;
+				float z = (state >> 12) % 4096 / 4096.0f * extent;
+				solidBlocks += chunkManager.isSolidBlock(x, y, z) ? 1 : 0;
+			}
+		});
+
+		// Short random walks, the access pattern of collisions and raycasts, through the manager and a view
+		const size_t walkLength = 64;
+		size_t walkSolid = 0;
+		size_t viewSolid = 0;
+		auto walk = [&](auto&& isSolid) {
+			size_t solid = 0;
+			uint32_t state = seed;
+			const int extent = gridSize * voxl::Chunk::CHUNK_SIZE;
+			glm::ivec3 pos(0);
+			for (size_t i = 0; i < queryCount; i++) {
+				state = state * 1664525u + 1013904223u;
+				if (i % walkLength == 0) {
+					pos = glm::ivec3((state >> 8) % extent, (state >> 4) % voxl::Chunk::CHUNK_HEIGHT, (state >> 12) % extent);
+				}
+				pos[(state >> 20) % 3] += (state >> 24) & 1 ? 1 : -1;
+				solid += isSolid(pos.x, pos.y, pos.z) ? 1 : 0;
+			}
+			return solid;
+		};
+		StageResult walkQueries = measure([&]() {
+			walkSolid = walk([&](int x, int y, int z) { return chunkManager.isSolidBlock(x, y, z); });
+		});
+		StageResult viewQueries = measure([&]() {
+			voxl::WorldView view(chunkManager);
+			viewSolid = walk([&](int x, int y, int z) { return view.isSolid(x, y, z); });
+		});
+
+		// Empty sections are skipped by the game without building a snapshot, do the same here
+		std::vector<std::unique_ptr<voxl::ChunkSnapshot>> snapshots;
+		snapshots.reserve(chunkCount * voxl::Chunk::SECTION_COUNT);
+		size_t skippedSections = 0;
+		StageResult snapshot = measure([&]() {
+			for (voxl::Chunk* chunk : chunks) {
+				for (int section = 0; section < voxl::Chunk::SECTION_COUNT; section++) {
+					if (chunk->getSection(section).isEmpty()) {
+						skippedSections++;
+						continue;
+					}
+					snapshots.push_back(std::make_unique<voxl::ChunkSnapshot>(*chunk, section, chunkManager));
+				}
+			}
+		});
+
+		size_t visibleFaces = 0;
+		StageResult cull = measure([&]() {
+			for (const auto& chunkSnapshot : snapshots) {
+				for (int x = 0; x < voxl::ChunkSection::SIZE; x++) {
+					for (int y = 0; y < voxl::ChunkSection::SIZE; y++) {
+						for (int z = 0; z < voxl::ChunkSection::SIZE; z++) {
+							voxl::BlockType type = chunkSnapshot->get(x, y, z);
+							if (type == voxl::BlockType::None) {
+								continue;
+							}
+							for (int direction = 0; direction < 6; direction++) {
+								visibleFaces += chunkSnapshot->isFaceVisible(x, y, z, direction, type) ? 1 : 0;
+							}
+						}
+					}
+				}
+			}
+		});
+
+		// Same culling done a column at a time with bitmasks, as the mesher does it
+		size_t maskedFaces = 0;
+		StageResult cullMasks = measure([&]() {
+			for (const auto& chunkSnapshot : snapshots) {
+				maskedFaces += voxl::FaceMasks(*chunkSnapshot).getFaceCount();
+			}
+		});
+
+		size_t naiveQuads = 0;
+		StageResult naive = measure([&]() {
+			for (const auto& chunkSnapshot : snapshots) {
+				naiveQuads += voxl::ChunkMesher::buildMesh(*chunkSnapshot, voxl::MeshingMode::Naive).quadCount;
+			}
+		});
+
+		size_t greedyQuads = 0;
+		StageResult greedy = measure([&]() {
+			for (const auto& chunkSnapshot : snapshots) {
+				greedyQuads += voxl::ChunkMesher::buildMesh(*chunkSnapshot, voxl::MeshingMode::Greedy).quadCount;
+			}
+		});
+
+		// Same greedy meshing spread over the background workers the game uses
+		StageResult threaded = measure([&]() {
+			for (const auto& chunkSnapshot : snapshots) {
+				const voxl::ChunkSnapshot* source = chunkSnapshot.get();
+				workers.submit([source]() {
+					voxl::ChunkMesher::buildMesh(*source, voxl::MeshingMode::Greedy);
+				});
+			}
+			workers.wait();
+		});
+
+		printStage("generate", generate, chunkCount, 0);
+		printStage("light", light, chunkCount, 0);
+		printStage("snapshot", snapshot, chunkCount, 0);
+		printStage("cull", cull, chunkCount, visibleFaces);
+		printStage("cull masks", cullMasks, chunkCount, maskedFaces);
+		printStage("mesh naive", naive, chunkCount, visibleFaces);
+		printStage("mesh greedy", greedy, chunkCount, visibleFaces);
+		printStage("mesh workers", threaded, chunkCount, visibleFaces);
+
+		printf("  %zu block queries in %.2f ms (%.1f ns each, %zu solid)\n",
+			queryCount, queries.seconds * 1000.0, queries.seconds * 1e9 / queryCount, solidBlocks);
+		printf("  %zu walk queries: manager %.1f ns, view %.1f ns each (%zu / %zu solid%s)\n",
+			queryCount, walkQueries.seconds * 1e9 / queryCount, viewQueries.seconds * 1e9 / queryCount,
+			walkSolid, viewSolid, walkSolid == viewSolid ? "" : ", MISMATCH");
+
+		voxl::ChunkMemoryStats memoryStats = chunkManager.getMemoryStats();
+		printf("  visible faces %zu, naive quads %zu, greedy quads %zu (%.2fx)\n",
+			visibleFaces, naiveQuads, greedyQuads, greedyQuads > 0 ? static_cast<double>(naiveQuads) / greedyQuads : 0.0);
+		if (maskedFaces != visibleFaces) {
+			printf("  face count mismatch: per voxel %zu, bitmask %zu\n", visibleFaces, maskedFaces);
+		}
+		printf("  sections meshed %zu, skipped %zu\n", snapshots.size(), skippedSections);
+		voxl::TerrainCacheStats terrainStats = chunkManager.getTerrain().getStats();
+		printf("  terrain tiles %zu, hits %zu, misses %zu\n", terrainStats.tileCount, terrainStats.hits, terrainStats.misses);
+		printf("  voxel memory %.2f MiB (dense %.2f MiB)\n\n",
+			memoryStats.voxelBytes / (1024.0 * 1024.0), memoryStats.denseBytes / (1024.0 * 1024.0));
+	}
+
+	return 0;
+}
@@ -0,0 +1,100 @@
+// Headless world pre-generation: fills a rectangle of chunks ahead of time and writes it to
+// the region files of a world, so players don't wait on generation when they first get there.
+// Builds only the world code, no window or GL context is created.
+
+#include "chunk.h"
+#include "chunk_manager.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+namespace {
+
+struct PregenOptions {
+	std::string worldPath = "world";
+	unsigned int seed = voxl::ChunkManager::DEFAULT_SEED;
+	glm::ivec3 minChunk = glm::ivec3(0);
+	glm::ivec3 maxChunk = glm::ivec3(0);
+	bool hasArea = false;
+};
+
+void printUsage(const char* program)
+{
+	printf("Usage: %s --area X0 Z0 X1 Z1 [--world PATH] [--seed S]\n", program);
+	printf("  --area X0 Z0 X1 Z1  chunk coordinates of two opposite corners, both included\n");
+	printf("  --world PATH        world directory (default world)\n");
+	printf("  --seed S            seed of a new world, an existing world keeps its own (default %u)\n", voxl::ChunkManager::DEFAULT_SEED);
+}
+
+bool parseOptions(int argc, char** argv, PregenOptions& options)
+{
+	for (int i = 1; i < argc; i++) {
+		if (std::strcmp(argv[i], "--area") == 0 && i + 4 < argc) {
+			int x0 = std::atoi(argv[++i]);
+			int z0 = std::atoi(argv[++i]);
+			int x1 = std::atoi(argv[++i]);
+			int z1 = std::atoi(argv[++i]);
+			options.minChunk = glm::ivec3(std::min(x0, x1), 0, std::min(z0, z1));
+			options.maxChunk = glm::ivec3(std::max(x0, x1), 0, std::max(z0, z1));
+			options.hasArea = true;
+		}
+		else if (std::strcmp(argv[i], "--world") == 0 && i + 1 < argc) {
+			options.worldPath = argv[++i];
+		}
+		else if (std::strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+			options.seed = static_cast<unsigned int>(std::strtoul(argv[++i], nullptr, 10));
+		}
+		else {
+			return false;
+		}
+	}
+	return options.hasArea && !options.worldPath.empty();
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+	PregenOptions options;
+	if (!parseOptions(argc, argv, options)) {
+		printUsage(argv[0]);
+		return 1;
+	}
+
+	voxl::ChunkManager chunkManager(options.worldPath, options.seed);
+	const glm::ivec3 size = options.maxChunk - options.minChunk + glm::ivec3(1);
+	const size_t areaCount = static_cast<size_t>(size.x) * size.z;
+	printf("world %s, seed %u, chunks (%d, %d) to (%d, %d), %zu worker threads\n", options.worldPath.c_str(), chunkManager.getSeed(),
+		options.minChunk.x, options.minChunk.z, options.maxChunk.x, options.maxChunk.z, chunkManager.getWorkerCount());
+
+	auto start = std::chrono::steady_clock::now();
+	chunkManager.pregenerate(options.minChunk, options.maxChunk);
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	voxl::ChunkStorageStats storage = chunkManager.getStorageStats();
+	voxl::ChunkStageStats stages = chunkManager.getStageStats();
+	printf("generated %zu chunks in %.2f s, %.1f chunks/s (%zu already on disk)\n",
+		storage.generatedCount, seconds, storage.generatedCount / seconds, areaCount - storage.generatedCount);
+	printf("wrote %zu chunks, %.2f MiB (%.1f KiB per chunk)\n", storage.savedCount, storage.savedBytes / (1024.0 * 1024.0),
+		storage.savedCount > 0 ? storage.savedBytes / 1024.0 / storage.savedCount : 0.0);
+
+	// Worker stages add up the time of every thread, saving runs on the main thread
+	printf("  %-10s %10s %10s\n", "stage", "total ms", "ms/chunk");
+	for (voxl::ChunkStage stage : { voxl::ChunkStage::Terrain, voxl::ChunkStage::Fluids, voxl::ChunkStage::Decorated }) {
+		int index = static_cast<int>(stage);
+		printf("  %-10s %10.1f %10.3f\n", voxl::getStageName(stage), stages.totalMs[index],
+			stages.completedCount[index] > 0 ? stages.totalMs[index] / stages.completedCount[index] : 0.0);
+	}
+	printf("  %-10s %10.1f %10.3f\n", "save", storage.saveMs, storage.savedCount > 0 ? storage.saveMs / storage.savedCount : 0.0);
+	printf("%zu decoration blocks wait for chunks outside the area\n", stages.pendingWriteCount);
+
+	if (storage.savedCount < storage.generatedCount) {
+		fprintf(stderr, "%zu chunks could not be written\n", storage.generatedCount - storage.savedCount);
+		return 1;
+	}
+	return 0;
+}